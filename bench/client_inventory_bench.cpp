@@ -0,0 +1,130 @@
+// SEARCH-to-OFFER latency on the seller side: parse the SEARCH datagram, find
+// the listing and encode the OFFER. The vector scan is how the client kept its
+// inventory before; the index is ClientInventory.
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/client/ClientInventory.h"
+#include "../src/util/ItemMatch.h"
+#include "../src/util/MessageParser.h"
+#include "../src/util/WireCodec.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kSearches = 2000;
+
+struct Item {
+    std::string name;
+    std::string description;
+    double price;
+};
+
+std::string itemName(size_t n) {
+    return "sku-" + std::to_string(n * 2654435761u % 1000003);
+}
+
+std::vector<std::string> searchDatagrams(size_t inventory, bool fuzzy) {
+    std::vector<std::string> datagrams;
+    for (size_t i = 0; i < kSearches; ++i) {
+        std::string name = itemName(i * 7919 % inventory);
+        if (fuzzy) {
+            name.back() = name.back() == 'x' ? 'y' : 'x';
+        }
+        json search = {
+            {"command", "SEARCH"}, {"rq", static_cast<int>(i)}, {"item_name", name},
+            {"description", "bench"}, {"fuzzy", fuzzy}
+        };
+        datagrams.push_back(search.dump());
+    }
+    return datagrams;
+}
+
+template <typename Find>
+void run(const std::string& label, size_t inventory, const std::vector<std::string>& datagrams, Find find) {
+    std::vector<double> latencies;
+    latencies.reserve(datagrams.size());
+    size_t offers = 0;
+    size_t bytes = 0;
+
+    for (const auto& datagram : datagrams) {
+        auto start = Clock::now();
+        auto event = MessageParser::parseMessage(datagram);
+        const auto& data = event->getData();
+        if (const Item* match = find(data.item_name, data.fuzzy)) {
+            json offer = {
+                {"command", "OFFER"}, {"rq", data.request_number}, {"name", "seller"},
+                {"item_name", match->name}, {"price", match->price}
+            };
+            bytes += WireCodec::encode(offer, WireEncoding::JSON).size();
+            ++offers;
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << std::left << std::setw(14) << label
+        << std::right << std::setw(8) << inventory << " items"
+        << std::setw(10) << std::fixed << std::setprecision(1) << latencies[latencies.size() / 2] << " us p50"
+        << std::setw(10) << latencies[latencies.size() * 99 / 100] << " us p99"
+        << std::setw(7) << offers << " offers" << std::setw(9) << bytes << " bytes" << std::endl;
+}
+}
+
+int main() {
+    std::cout << kSearches << " SEARCH datagrams per run\n" << std::endl;
+
+    for (size_t inventory : {1000, 10000, 100000}) {
+        std::vector<Item> items;
+        ClientInventory index;
+        for (size_t i = 0; i < inventory; ++i) {
+            std::string name = itemName(i);
+            double price = 10.0 + static_cast<double>(i % 500);
+            items.push_back({name, "bench", price});
+            index.add(name, "bench", price);
+        }
+
+        for (bool fuzzy : {false, true}) {
+            auto datagrams = searchDatagrams(inventory, fuzzy);
+            Item found;
+
+            run(fuzzy ? "vector fuzzy" : "vector exact", inventory, datagrams,
+                [&](const std::string& query, bool is_fuzzy) -> const Item* {
+                    if (!is_fuzzy) {
+                        auto it = std::find_if(items.begin(), items.end(),
+                                               [&](const Item& item) { return item.name == query; });
+                        return it != items.end() ? &*it : nullptr;
+                    }
+                    std::string normalized = ItemMatch::normalize(query);
+                    size_t max_edits = ItemMatch::maxEdits(normalized.size());
+                    size_t best = max_edits + 1;
+                    const Item* match = nullptr;
+                    for (const auto& item : items) {
+                        size_t distance = ItemMatch::prefixDistance(normalized, ItemMatch::normalize(item.name), max_edits);
+                        if (distance < best || (match && distance == best && item.price < match->price)) {
+                            best = distance;
+                            match = &item;
+                        }
+                    }
+                    return match;
+                });
+
+            run(fuzzy ? "indexed fuzzy" : "indexed exact", inventory, datagrams,
+                [&](const std::string& query, bool is_fuzzy) -> const Item* {
+                    const ClientInventory::Listing* listing = is_fuzzy ? index.closest(query) : index.cheapest(query);
+                    if (!listing) {
+                        return nullptr;
+                    }
+                    found = {listing->name, listing->description, listing->price};
+                    return &found;
+                });
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Producer contention on the event queue: the old mutex + condition variable
+// queue against the bounded lock-free ring, one consumer as in processEvents.
+
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/util/ConcurrentQueue.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kItemsPerRun = 2000000;
+constexpr size_t kBulkSize = 64;
+
+// ConcurrentQueue as it was before the ring: unbounded, one lock for everything
+template <typename T>
+class MutexQueue {
+public:
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_.push(std::move(item));
+        lock.unlock();
+        cond_.notify_one();
+    }
+
+    void wait_and_pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return !queue_.empty(); });
+        item = std::move(queue_.front());
+        queue_.pop();
+    }
+
+private:
+    std::queue<T> queue_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+template <typename Queue, typename Consume>
+void run(const std::string& label, size_t producers, Consume consume) {
+    Queue queue;
+    size_t per_producer = kItemsPerRun / producers;
+    size_t total = per_producer * producers;
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, per_producer] {
+            for (size_t i = 0; i < per_producer; ++i) {
+                queue.push(i);
+            }
+        });
+    }
+
+    uint64_t checksum = consume(queue, total);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << std::left << std::setw(14) << label
+        << std::right << std::setw(4) << producers << " producers"
+        << std::setw(14) << std::fixed << std::setprecision(0) << total / seconds << " items/s"
+        << "   (checksum " << checksum << ")" << std::endl;
+}
+
+template <typename Queue>
+uint64_t consumeOne(Queue& queue, size_t total) {
+    uint64_t checksum = 0;
+    size_t item{};
+    for (size_t n = 0; n < total; ++n) {
+        queue.wait_and_pop(item);
+        checksum += item;
+    }
+    return checksum;
+}
+
+uint64_t consumeBulk(ConcurrentQueue<size_t>& queue, size_t total) {
+    uint64_t checksum = 0;
+    std::vector<size_t> items;
+    items.reserve(kBulkSize);
+    for (size_t n = 0; n < total;) {
+        n += queue.pop_bulk(items, kBulkSize);
+        for (size_t item : items) {
+            checksum += item;
+        }
+        items.clear();
+    }
+    return checksum;
+}
+}
+
+int main() {
+    std::cout << kItemsPerRun << " items per run, 1 consumer, ring capacity "
+        << ConcurrentQueue<size_t>::kDefaultCapacity << "\n" << std::endl;
+
+    for (size_t producers : {1, 2, 4, 8, 16, 32}) {
+        run<MutexQueue<size_t>>("mutex", producers, consumeOne<MutexQueue<size_t>>);
+        run<ConcurrentQueue<size_t>>("ring", producers, consumeOne<ConcurrentQueue<size_t>>);
+        run<ConcurrentQueue<size_t>>("ring bulk", producers, consumeBulk);
+    }
+    return 0;
+}
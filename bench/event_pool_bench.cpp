@@ -0,0 +1,153 @@
+// Heap allocations per message from payload to consumed event. "before" is the
+// old path: a make_shared P2PEvent per message, MessageData strings copied out
+// of the json, and a new shared_ptr state per transition. "after" is
+// MessageParser with P2PEventPool and the enum state machines. Decoding the
+// payload into json is shown on its own since both paths pay for it.
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/server/PeerStateMachine.h"
+#include "../src/util/ConcurrentQueue.h"
+#include "../src/util/MessageParser.h"
+#include "../src/util/WireCodec.h"
+#include "alloc_counter.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kMessages = 300000;
+
+// Names long enough to leave the small-string buffer, as real ones do
+std::vector<std::string> makePayloads() {
+    std::vector<std::string> payloads;
+    payloads.reserve(kMessages);
+    for (size_t i = 0; i < kMessages; ++i) {
+        json j;
+        switch (i % 3) {
+        case 0:
+            j = {{"command", "LOOKING_FOR"}, {"rq", i}, {"name", "buyer-peer-" + std::to_string(i % 1000)},
+                 {"item_name", "mechanical-keyboard"}, {"description", "tenkeyless with brown switches"},
+                 {"max_price", 120.0}};
+            break;
+        case 1:
+            j = {{"command", "OFFER"}, {"rq", i}, {"name", "seller-peer-" + std::to_string(i % 1000)},
+                 {"item_name", "mechanical-keyboard"}, {"price", 99.5}};
+            break;
+        default:
+            j = {{"command", "REGISTER"}, {"rq", i}, {"name", "registering-peer-" + std::to_string(i % 1000)},
+                 {"ip", "192.168.100.200"}, {"udp_port", 5000}, {"tcp_port", 5001}};
+            break;
+        }
+        payloads.push_back(j.dump());
+    }
+    return payloads;
+}
+
+// MessageParser as it was: fields copied out of the json into a fresh event
+std::shared_ptr<P2PEvent> parseBefore(const std::string& payload) {
+    json j = WireCodec::decode(payload);
+    P2PEvent::MessageData data{j["rq"].get<int>(), j.value("name", "")};
+    auto type = j["command"] == "LOOKING_FOR" ? P2PEventType::LOOKING_FOR
+        : j["command"] == "OFFER" ? P2PEventType::OFFER : P2PEventType::REGISTER;
+    switch (type) {
+    case P2PEventType::REGISTER:
+        data.ip_address = j["ip"];
+        data.udp_port = j["udp_port"];
+        data.tcp_port = j["tcp_port"];
+        data.encoding = j.value("encoding", "json");
+        break;
+    case P2PEventType::LOOKING_FOR:
+        data.item_name = j["item_name"];
+        data.item_description = j["description"];
+        data.max_price = j["max_price"];
+        break;
+    default:
+        data.item_name = j["item_name"];
+        data.price = j["price"];
+        break;
+    }
+    return std::make_shared<P2PEvent>(type, std::move(data));
+}
+
+void report(const std::string& label, double seconds, uint64_t allocated) {
+    std::cout << std::left << std::setw(22) << label
+        << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+        << static_cast<double>(allocated) / kMessages << " allocs/msg"
+        << std::setw(12) << std::setprecision(0) << kMessages / seconds << " msg/s" << std::endl;
+}
+
+template <typename Body>
+void measure(const std::string& label, Body body) {
+    auto payloads = makePayloads();
+    uint64_t before = allocations.load();
+    auto start = Clock::now();
+    body(payloads);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report(label, seconds, allocations.load() - before);
+}
+
+std::atomic<uint64_t> sink{0};
+}
+
+int main() {
+    std::cout << "Messages: " << kMessages << " (LOOKING_FOR / OFFER / REGISTER)\n" << std::endl;
+
+    measure("json decode only", [](const std::vector<std::string>& payloads) {
+        for (const auto& payload : payloads) {
+            sink += WireCodec::decode(payload).size();
+        }
+    });
+
+    measure("before", [](const std::vector<std::string>& payloads) {
+        auto state = std::make_shared<P2PState>(P2PStateType::UNREGISTERED);
+        for (const auto& payload : payloads) {
+            auto event = parseBefore(payload);
+            state = std::make_shared<P2PState>(P2PStateType::REGISTERING);
+            sink += event->getData().request_number;
+        }
+    });
+
+    // Warm the pool so the run shows the steady state
+    for (const auto& payload : makePayloads()) {
+        MessageParser::parseMessage(payload);
+    }
+
+    measure("after", [](const std::vector<std::string>& payloads) {
+        PeerStateMachine machine;
+        for (const auto& payload : payloads) {
+            auto event = MessageParser::parseMessage(payload);
+            machine.processEvent(event->getType());
+            sink += event->getData().request_number;
+        }
+    });
+
+    // Parsed on one thread and released on another, like workers and partitions
+    measure("after, cross-thread", [](const std::vector<std::string>& payloads) {
+        ConcurrentQueue<P2PEventPool::Handle> queue(1024);
+        std::thread consumer([&] {
+            PeerStateMachine machine;
+            P2PEventPool::Handle event;
+            while (queue.wait_and_pop(event)) {
+                machine.processEvent(event->getType());
+                event.reset();
+            }
+        });
+        for (const auto& payload : payloads) {
+            queue.push(MessageParser::parseMessage(payload));
+        }
+        queue.close();
+        consumer.join();
+    });
+
+    auto stats = P2PEventPool::getStats();
+    std::cout << "\nPool: " << stats.created << " created, " << stats.reused << " reused, "
+        << stats.depot_size << " in depot" << std::endl;
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Cost of collecting SEARCH recipients: walking every registered peer, as the
+// server did before, against asking the inventory index for the item's sellers.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/server/InventoryIndex.h"
+#include "../src/server/PeerRegistry.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kItemsPerPeer = 8;
+constexpr size_t kCatalogue = 50000;
+constexpr size_t kSearches = 2000;
+
+std::string itemName(size_t n) {
+    return "item-" + std::to_string(n % kCatalogue);
+}
+
+template <typename Collect>
+void run(const std::string& label, size_t peers, Collect collect) {
+    std::vector<sockaddr_in> recipients;
+    size_t total = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < kSearches; ++i) {
+        recipients.clear();
+        collect(itemName(i * 7919), recipients);
+        total += recipients.size();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << std::left << std::setw(10) << label
+        << std::right << std::setw(9) << peers << " peers"
+        << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e6 / kSearches << " us/search"
+        << std::setw(12) << std::setprecision(1) << static_cast<double>(total) / kSearches << " recipients" << std::endl;
+}
+}
+
+int main() {
+    std::cout << kItemsPerPeer << " items per peer from a catalogue of " << kCatalogue << "\n" << std::endl;
+
+    for (size_t peers : {1000, 10000, 100000}) {
+        PeerRegistry registry;
+        InventoryIndex index;
+        for (size_t p = 0; p < peers; ++p) {
+            std::string peer_id = "10.0." + std::to_string(p / 256) + "." + std::to_string(p % 256) + ":5000";
+            auto session = std::make_shared<PeerSession>(-1, sockaddr_in{});
+            std::vector<std::string> items;
+            for (size_t i = 0; i < kItemsPerPeer; ++i) {
+                items.push_back(itemName(p * kItemsPerPeer + i));
+            }
+            registry.insert(peer_id, session);
+            index.publish(peer_id, session, items);
+        }
+
+        run("broadcast", peers, [&](const std::string&, std::vector<sockaddr_in>& out) {
+            registry.forEach([&](const PeerRegistry::Entry& entry) {
+                out.push_back(entry.session->getPeerAddr());
+            });
+        });
+        run("indexed", peers, [&](const std::string& item, std::vector<sockaddr_in>& out) {
+            index.forEachCandidate(item, false, [&](const PeerRegistry::Entry& entry, bool) {
+                out.push_back(entry.session->getPeerAddr());
+            });
+        });
+    }
+    return 0;
+}
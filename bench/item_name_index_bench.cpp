@@ -0,0 +1,102 @@
+// Prefix and fuzzy item-name lookups with a million listed names, against a
+// linear scan with the same matching rule.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/util/ItemNameIndex.h"
+#include "../src/util/ItemMatch.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kNames = 1000000;
+constexpr size_t kLookups = 20000;
+constexpr size_t kMaxResults = 32;
+
+const char* const kBrands[] = {
+    "acme", "lenovo", "dell", "apple", "samsung", "sony", "logitech", "asus", "canon", "nikon",
+    "bose", "philips", "garmin", "fender", "yamaha", "makita", "bosch", "dyson", "lego", "nintendo",
+    "razer", "corsair", "kingston", "seagate", "anker", "xiaomi", "huawei", "oneplus", "google", "microsoft"
+};
+const char* const kProducts[] = {
+    "laptop", "keyboard", "mouse", "monitor", "headphones", "speaker", "camera", "lens", "tablet", "phone",
+    "charger", "router", "drill", "guitar", "piano", "watch", "console", "controller", "printer", "scanner",
+    "vacuum", "blender", "kettle", "toaster", "projector", "microphone", "webcam", "drive", "cable", "dock",
+    "stand", "lamp", "fan", "heater", "bike", "helmet", "backpack", "tent", "stove", "cooler"
+};
+
+std::string makeName(size_t n) {
+    size_t brand = n % std::size(kBrands);
+    size_t product = (n / std::size(kBrands)) % std::size(kProducts);
+    size_t model = n / (std::size(kBrands) * std::size(kProducts));
+    return std::string(kBrands[brand]) + "-" + kProducts[product] + "-x" + std::to_string(model);
+}
+
+template <typename Lookup>
+void run(const std::string& label, const std::vector<std::string>& queries, size_t lookups, Lookup lookup) {
+    size_t found = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        found += lookup(queries[i % queries.size()]);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << std::left << std::setw(34) << label
+        << std::right << std::setw(12) << std::fixed << std::setprecision(2) << seconds * 1e6 / lookups << " us/lookup"
+        << std::setw(10) << std::setprecision(1) << static_cast<double>(found) / lookups << " matches" << std::endl;
+}
+}
+
+int main() {
+    std::vector<std::string> names;
+    names.reserve(kNames);
+    for (size_t i = 0; i < kNames; ++i) {
+        names.push_back(makeName(i));
+    }
+
+    ItemNameIndex index;
+    auto start = Clock::now();
+    for (const auto& name : names) {
+        index.insert(name);
+    }
+    double build = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "Names: " << index.size() << ", built in " << std::setprecision(2) << std::fixed
+        << build << "s\n" << std::endl;
+
+    const std::vector<std::string> prefixes = {"Lenovo-Laptop-x12", "sony-cam", "dyson-vacuum-x7", "lego"};
+    // Typos short enough for the trie walk, and long ones for the trigram filter
+    const std::vector<std::string> short_typos = {"lenvo", "snoy-c", "dysn", "appel"};
+    const std::vector<std::string> long_typos = {"lenovo-lpatop-x123", "samsnug-monitr-x45", "logitech-keybaord-x9"};
+
+    run("prefix", prefixes, kLookups, [&](const std::string& query) {
+        return index.prefixMatches(query, kMaxResults).size();
+    });
+    run("fuzzy, short query", short_typos, kLookups, [&](const std::string& query) {
+        return index.fuzzyMatches(query, kMaxResults).size();
+    });
+    run("fuzzy, long query", long_typos, kLookups, [&](const std::string& query) {
+        return index.fuzzyMatches(query, kMaxResults).size();
+    });
+
+    // The scan has to look at every name, so it gets far fewer rounds
+    std::vector<std::string> normalized;
+    normalized.reserve(names.size());
+    for (const auto& name : names) {
+        normalized.push_back(ItemMatch::normalize(name));
+    }
+    run("linear scan, long query", long_typos, 30, [&](const std::string& query) {
+        std::string q = ItemMatch::normalize(query);
+        size_t max_edits = ItemMatch::maxEdits(q.size());
+        std::vector<size_t> row;
+        std::vector<size_t> next;
+        size_t found = 0;
+        for (const auto& name : normalized) {
+            found += ItemMatch::prefixDistance(q, name, max_edits, row, next) <= max_edits;
+        }
+        return found;
+    });
+    return 0;
+}
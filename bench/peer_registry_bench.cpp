@@ -0,0 +1,143 @@
+// Registration throughput while large SEARCH broadcasts iterate the registry.
+// Compares the old single-mutex map against the sharded PeerRegistry.
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/server/PeerRegistry.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kResidentPeers = 50000;
+constexpr auto kDuration = std::chrono::seconds(2);
+
+// The layout ServerCommandHandlers used before: one map behind one mutex,
+// with the broadcast walking the whole map under that mutex
+class MutexMapRegistry {
+public:
+    bool insert(const std::string& peer_id, std::shared_ptr<PeerSession> session) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessions_.emplace(peer_id, std::move(session)).second;
+    }
+
+    bool erase(const std::string& peer_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessions_.erase(peer_id) > 0;
+    }
+
+    std::vector<sockaddr_in> collect(const std::string& exclude) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<sockaddr_in> recipients;
+        recipients.reserve(sessions_.size());
+        for (const auto& [peer_id, session] : sessions_) {
+            if (peer_id != exclude) {
+                recipients.push_back(session->getPeerAddr());
+            }
+        }
+        return recipients;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<PeerSession>> sessions_;
+};
+
+class ShardedRegistry {
+public:
+    bool insert(const std::string& peer_id, std::shared_ptr<PeerSession> session) {
+        return registry_.insert(peer_id, std::move(session));
+    }
+
+    bool erase(const std::string& peer_id) { return registry_.erase(peer_id); }
+
+    std::vector<sockaddr_in> collect(const std::string& exclude) {
+        std::vector<sockaddr_in> recipients;
+        recipients.reserve(registry_.size());
+        registry_.forEach([&](const PeerRegistry::Entry& entry) {
+            if (entry.peer_id != exclude) {
+                recipients.push_back(entry.session->getPeerAddr());
+            }
+        });
+        return recipients;
+    }
+
+private:
+    PeerRegistry registry_;
+};
+
+std::string peerId(size_t thread, size_t n) {
+    return "10." + std::to_string(thread) + "." + std::to_string(n / 65536) + ":" + std::to_string(n % 65536);
+}
+
+template <typename Registry>
+void run(const std::string& label, size_t registrars, size_t broadcasters) {
+    Registry registry;
+    auto session = std::make_shared<PeerSession>(-1, sockaddr_in{});
+    for (size_t i = 0; i < kResidentPeers; ++i) {
+        registry.insert(peerId(255, i), session);
+    }
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> registrations{0};
+    std::atomic<uint64_t> broadcasts{0};
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < registrars; ++t) {
+        threads.emplace_back([&, t] {
+            uint64_t count = 0;
+            for (size_t n = 0; running.load(std::memory_order_relaxed); ++n) {
+                std::string id = peerId(t, n);
+                registry.insert(id, session);
+                registry.erase(id);
+                ++count;
+            }
+            registrations += count;
+        });
+    }
+
+    for (size_t t = 0; t < broadcasters; ++t) {
+        threads.emplace_back([&] {
+            uint64_t count = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                if (!registry.collect("searcher").empty()) {
+                    ++count;
+                }
+            }
+            broadcasts += count;
+        });
+    }
+
+    auto start = Clock::now();
+    std::this_thread::sleep_for(kDuration);
+    running = false;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << std::left << std::setw(12) << label
+        << std::right << std::setw(4) << registrars << " reg / " << broadcasters << " bcast"
+        << std::setw(14) << std::fixed << std::setprecision(0) << registrations / seconds << " reg/s"
+        << std::setw(10) << std::setprecision(1) << broadcasts / seconds << " bcast/s" << std::endl;
+}
+}
+
+int main() {
+    std::cout << "Resident peers: " << kResidentPeers << ", " << kDuration.count() << "s per run\n" << std::endl;
+
+    for (size_t broadcasters : {0, 1, 4}) {
+        for (size_t registrars : {1, 4}) {
+            run<MutexMapRegistry>("mutex-map", registrars, broadcasters);
+            run<ShardedRegistry>("sharded", registrars, broadcasters);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,229 @@
+// End to end SEARCH fan-out over loopback: sellers register with a published
+// inventory, one buyer sends LOOKING_FOR requests, and the sellers count the
+// SEARCH messages that reach them. Prints the server's broadcast and inventory
+// counters next to the timing, once per backend. Then stops servers while
+// searches and messages are still queued, which has to tear down cleanly.
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+
+#include "../src/server/ConcurrentServer.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr uint16_t kPort = 38366;
+constexpr size_t kSellers = 64;
+// Each item is sold by kSellers / kItems sellers
+constexpr size_t kItems = 8;
+constexpr size_t kSearches = 2000;
+constexpr auto kDeadline = std::chrono::seconds(10);
+// Searches sent but not yet fanned out; more would overrun the server's socket buffer
+constexpr size_t kWindow = 128;
+constexpr size_t kShutdownRounds = 20;
+// Sent without waiting, so stop() lands while most of them are still queued
+constexpr size_t kInFlight = 500;
+
+sockaddr_in serverAddress() {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+int openPeer() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    int buffer = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    return fd;
+}
+
+void send(int fd, const json& message) {
+    std::string payload = message.dump();
+    sockaddr_in server = serverAddress();
+    sendto(fd, payload.data(), payload.size(), 0, reinterpret_cast<sockaddr*>(&server), sizeof(server));
+}
+
+// Blocks until the fd has a datagram or the timeout passes
+bool receive(int fd, std::chrono::milliseconds timeout) {
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(timeout.count())) <= 0) {
+        return false;
+    }
+    char buffer[4096];
+    return recv(fd, buffer, sizeof(buffer), 0) > 0;
+}
+
+// A server that just shut down may hold the port a little longer while the
+// kernel tears down its io_uring, so binding is retried briefly
+std::unique_ptr<ConcurrentServer> makeServer(IoBackend backend) {
+    for (int attempt = 0;; ++attempt) {
+        try {
+            return std::make_unique<ConcurrentServer>(ConcurrentServer::ServerConfig{kPort, 4, 1, backend});
+        }
+        catch (const std::exception&) {
+            if (attempt == 50) {
+                throw;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+}
+
+void registerPeer(int fd, const std::string& name, const std::vector<std::string>& inventory) {
+    send(fd, {
+        {"command", "REGISTER"}, {"rq", 1}, {"name", name}, {"ip", "127.0.0.1"},
+        {"udp_port", 0}, {"tcp_port", 0}, {"inventory", inventory}
+    });
+    receive(fd, std::chrono::milliseconds(1000));
+}
+
+// Counts SEARCH datagrams across all sellers until the expected total arrives
+void collect(const std::vector<int>& sellers, size_t expected, std::atomic<size_t>& received) {
+    std::vector<pollfd> fds;
+    for (int fd : sellers) {
+        fds.push_back({fd, POLLIN, 0});
+    }
+    char buffer[4096];
+    auto deadline = Clock::now() + kDeadline;
+    while (received.load(std::memory_order_relaxed) < expected && Clock::now() < deadline) {
+        if (poll(fds.data(), fds.size(), 100) <= 0) {
+            continue;
+        }
+        for (auto& pfd : fds) {
+            if (!(pfd.revents & POLLIN)) {
+                continue;
+            }
+            while (recv(pfd.fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+                received.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void run(IoBackend backend) {
+    auto server = makeServer(backend);
+    std::thread server_thread([&] { server->start(); });
+
+    std::vector<int> sellers;
+    for (size_t s = 0; s < kSellers; ++s) {
+        sellers.push_back(openPeer());
+        registerPeer(sellers.back(), "seller-" + std::to_string(s), {"item-" + std::to_string(s % kItems)});
+    }
+    int buyer = openPeer();
+    registerPeer(buyer, "buyer", {});
+
+    size_t fan_out = kSellers / kItems;
+    size_t expected = kSearches * fan_out;
+    std::atomic<size_t> received{0};
+    std::thread collector([&] { collect(sellers, expected, received); });
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < kSearches; ++i) {
+        while (i >= kWindow && received.load(std::memory_order_relaxed) < (i - kWindow) * fan_out
+               && Clock::now() - start < kDeadline) {
+            std::this_thread::yield();
+        }
+        send(buyer, {
+            {"command", "LOOKING_FOR"}, {"rq", static_cast<int>(i + 2)}, {"name", "buyer"},
+            {"item_name", "item-" + std::to_string(i % kItems)}, {"description", "bench"},
+            {"max_price", 100.0}
+        });
+    }
+    collector.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Counters are read once the server is stopped, after the last fan-out finished counting
+    server->stop();
+    server_thread.join();
+    auto broadcast = server->getBroadcastStats();
+    auto inventory = server->getInventoryStats();
+    std::cout << std::left << std::setw(10) << (server->getBackend() == IoBackend::IO_URING ? "io_uring" : "epoll")
+        << std::right << std::setw(10) << std::fixed << std::setprecision(1) << seconds * 1e6 / kSearches << " us/search"
+        << std::setw(8) << received.load() << "/" << expected << " delivered\n"
+        << "  broadcast: " << broadcast.broadcasts << " fan-outs, " << broadcast.recipients << " recipients, "
+        << broadcast.sent << " sent, " << broadcast.partial_sends << " partial, "
+        << broadcast.eagain_count << " EAGAIN, " << broadcast.dropped << " dropped\n"
+        << "  inventory: " << inventory.listings << " listings, " << inventory.listed_names << " names, "
+        << inventory.unindexed_peers << " unindexed" << std::endl;
+
+    for (int fd : sellers) {
+        close(fd);
+    }
+    close(buyer);
+}
+
+// Each round registers sellers, fires searches, offers and item updates, and
+// stops the server straight away with tasks and timeouts still pending
+void shutdownUnderLoad(IoBackend backend) {
+    std::chrono::duration<double> total_stop{0};
+    for (size_t round = 0; round < kShutdownRounds; ++round) {
+        auto server = makeServer(backend);
+        std::thread server_thread([&] { server->start(); });
+
+        std::vector<int> sellers;
+        for (size_t s = 0; s < kItems; ++s) {
+            sellers.push_back(openPeer());
+            registerPeer(sellers.back(), "seller-" + std::to_string(s), {"item-" + std::to_string(s)});
+        }
+        int buyer = openPeer();
+        registerPeer(buyer, "buyer", {});
+
+        for (size_t i = 0; i < kInFlight; ++i) {
+            std::string item = "item-" + std::to_string(i % kItems);
+            send(buyer, {
+                {"command", "LOOKING_FOR"}, {"rq", static_cast<int>(i + 2)}, {"name", "buyer"},
+                {"item_name", item}, {"description", "shutdown"}, {"max_price", 100.0}
+            });
+            int seller = sellers[i % kItems];
+            send(seller, {
+                {"command", "OFFER"}, {"rq", static_cast<int>(i + 1)}, {"name", "seller"},
+                {"item_name", item}, {"price", 50.0}
+            });
+            send(seller, {
+                {"command", "ADD_ITEM"}, {"rq", static_cast<int>(i + 2)}, {"name", "seller"},
+                {"item_name", item + "-extra"}
+            });
+        }
+
+        auto start = Clock::now();
+        server->stop();
+        server_thread.join();
+        server.reset();
+        total_stop += Clock::now() - start;
+
+        for (int fd : sellers) {
+            close(fd);
+        }
+        close(buyer);
+    }
+
+    std::cout << std::left << std::setw(10) << (backend == IoBackend::IO_URING ? "io_uring" : "epoll")
+        << std::right << std::setw(10) << kShutdownRounds << " rounds"
+        << std::setw(10) << std::fixed << std::setprecision(2) << total_stop.count() * 1e3 / kShutdownRounds
+        << " ms/stop with " << kInFlight * 3 << " messages in flight" << std::endl;
+}
+}
+
+int main() {
+    Logger::setLevel(LogLevel::OFF);
+    std::cout << kSellers << " sellers, " << kItems << " items, " << kSearches << " searches\n" << std::endl;
+    run(IoBackend::EPOLL);
+    run(IoBackend::IO_URING);
+
+    std::cout << "\nStopping under load\n" << std::endl;
+    shutdownUnderLoad(IoBackend::EPOLL);
+    shutdownUnderLoad(IoBackend::IO_URING);
+    return 0;
+}
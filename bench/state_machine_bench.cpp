@@ -0,0 +1,108 @@
+// Cost per transition of the string-keyed StateMachine the peer and server
+// machines used before against the enum-indexed table they use now.
+// Events alternate REGISTER / DE_REGISTER so every dispatch changes state,
+// with a miss (an event that has no transition) mixed in every fourth step.
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/server/PeerStateMachine.h"
+#include "alloc_counter.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kEvents = 4000000;
+
+const P2PEventType kCycle[] = {
+    P2PEventType::REGISTER, P2PEventType::DE_REGISTER, P2PEventType::SEARCH, P2PEventType::REGISTER,
+    P2PEventType::DE_REGISTER, P2PEventType::REGISTER, P2PEventType::DE_REGISTER, P2PEventType::OFFER
+};
+
+// The machine PeerStateMachine derived from before: names hashed per lookup,
+// a std::function per transition and a shared_ptr state allocated per hop
+class StringKeyedMachine : public StateMachine<P2PState, P2PEvent> {
+public:
+    StringKeyedMachine()
+        : StateMachine(std::make_shared<P2PState>(P2PStateType::UNREGISTERED)) {
+        addTransition(
+            std::make_shared<P2PState>(P2PStateType::UNREGISTERED),
+            std::make_shared<P2PEvent>(P2PEventType::REGISTER, P2PEvent::MessageData{0, ""}),
+            [](const std::shared_ptr<P2PEvent>&) {
+                return std::make_shared<P2PState>(P2PStateType::REGISTERING);
+            });
+        addTransition(
+            std::make_shared<P2PState>(P2PStateType::REGISTERING),
+            std::make_shared<P2PEvent>(P2PEventType::DE_REGISTER, P2PEvent::MessageData{0, ""}),
+            [](const std::shared_ptr<P2PEvent>&) {
+                return std::make_shared<P2PState>(P2PStateType::UNREGISTERED);
+            });
+    }
+};
+
+class EnumTableMachine : public StateMachine<P2PStateType, P2PEventType> {
+public:
+    EnumTableMachine() : StateMachine(P2PStateType::UNREGISTERED, kTransitions) {
+    }
+
+private:
+    static constexpr Table kTransitions = makeTable({
+        {P2PStateType::UNREGISTERED, P2PEventType::REGISTER, P2PStateType::REGISTERING},
+        {P2PStateType::REGISTERING, P2PEventType::DE_REGISTER, P2PStateType::UNREGISTERED},
+    });
+};
+
+void report(const std::string& label, double seconds, uint64_t allocated, uint64_t check) {
+    std::cout << std::left << std::setw(14) << label
+        << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+        << seconds * 1e9 / kEvents << " ns/event"
+        << std::setw(10) << std::setprecision(2) << static_cast<double>(allocated) / kEvents << " allocs/event"
+        << "   (" << check << ")" << std::endl;
+}
+
+void runStringKeyed() {
+    // The server builds one event object per datagram, so they are made up front
+    std::vector<std::shared_ptr<P2PEvent>> events;
+    events.reserve(std::size(kCycle));
+    for (P2PEventType type : kCycle) {
+        events.push_back(std::make_shared<P2PEvent>(type, P2PEvent::MessageData{0, ""}));
+    }
+    StringKeyedMachine machine;
+
+    uint64_t registering = 0;
+    uint64_t before = allocations.load();
+    auto start = Clock::now();
+    for (size_t i = 0; i < kEvents; ++i) {
+        machine.processEvent(events[i % events.size()]);
+        registering += machine.getCurrentState()->getType() == P2PStateType::REGISTERING;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report("string-keyed", seconds, allocations.load() - before, registering);
+}
+
+void runEnumTable() {
+    EnumTableMachine machine;
+
+    uint64_t registering = 0;
+    uint64_t before = allocations.load();
+    auto start = Clock::now();
+    for (size_t i = 0; i < kEvents; ++i) {
+        machine.processEvent(kCycle[i % std::size(kCycle)]);
+        registering += machine.getCurrentState() == P2PStateType::REGISTERING;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report("enum-table", seconds, allocations.load() - before, registering);
+}
+}
+
+int main() {
+    std::cout << "Events: " << kEvents << "\n" << std::endl;
+    runStringKeyed();
+    runEnumTable();
+    return 0;
+}
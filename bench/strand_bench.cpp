@@ -0,0 +1,117 @@
+// Per-peer ordering and throughput: plain pool dispatch, pool dispatch behind
+// one global handler mutex (how the server serialized handlers before), and
+// per-peer strands. Every task checks it follows the previous one of its peer.
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/util/StrandExecutor.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kPeers = 1024;
+constexpr size_t kProducers = 4;
+constexpr uint64_t kMessagesPerPeer = 500;
+constexpr size_t kWorkers = 8;
+
+struct alignas(64) Peer {
+    std::atomic<uint64_t> last_seq{0};
+};
+
+struct Run {
+    std::unique_ptr<Peer[]> peers{new Peer[kPeers]};
+    std::atomic<uint64_t> violations{0};
+    std::atomic<uint64_t> done{0};
+    std::atomic<uint64_t> sink{0};
+
+    void handle(size_t peer, uint64_t seq) {
+        // Roughly the cost of parsing and routing a small message
+        uint64_t x = seq;
+        for (int i = 0; i < 200; ++i) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+        sink.fetch_add(x & 1, std::memory_order_relaxed);
+
+        if (peers[peer].last_seq.exchange(seq, std::memory_order_relaxed) != seq - 1) {
+            violations.fetch_add(1, std::memory_order_relaxed);
+        }
+        done.fetch_add(1, std::memory_order_release);
+        done.notify_all();
+    }
+
+    void wait(uint64_t total) {
+        uint64_t seen;
+        while ((seen = done.load(std::memory_order_acquire)) < total) {
+            done.wait(seen);
+        }
+    }
+};
+
+// Each producer owns a slice of the peers, so per-peer post order is well defined
+template <typename Dispatch>
+void run(const std::string& label, Dispatch dispatch) {
+    Run state;
+    uint64_t total = kPeers * kMessagesPerPeer;
+
+    auto start = Clock::now();
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for (uint64_t seq = 1; seq <= kMessagesPerPeer; ++seq) {
+                for (size_t peer = p; peer < kPeers; peer += kProducers) {
+                    dispatch(state, peer, seq);
+                }
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    state.wait(total);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << std::left << std::setw(14) << label
+        << std::right << std::setw(12) << std::fixed << std::setprecision(0) << total / seconds << " msgs/s"
+        << std::setw(10) << state.violations.load() << " out of order" << std::endl;
+}
+}
+
+int main() {
+    std::cout << kPeers << " peers x " << kMessagesPerPeer << " messages, " << kProducers
+        << " producers, " << kWorkers << " workers\n" << std::endl;
+
+    {
+        ThreadPool pool(kWorkers);
+        run("pool", [&pool](Run& state, size_t peer, uint64_t seq) {
+            pool.post([&state, peer, seq] { state.handle(peer, seq); });
+        });
+    }
+    {
+        ThreadPool pool(kWorkers);
+        std::mutex handler_mutex;
+        run("pool + mutex", [&pool, &handler_mutex](Run& state, size_t peer, uint64_t seq) {
+            pool.post([&state, &handler_mutex, peer, seq] {
+                std::lock_guard<std::mutex> lock(handler_mutex);
+                state.handle(peer, seq);
+            });
+        });
+    }
+    {
+        ThreadPool pool(kWorkers);
+        StrandExecutor strands(pool);
+        run("strands", [&strands](Run& state, size_t peer, uint64_t seq) {
+            strands.post(peer, [&state, peer, seq] { state.handle(peer, seq); });
+        });
+        auto stats = strands.getStats();
+        std::cout << "  strands: " << stats.strands << " live, " << stats.yields << " budget yields" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Heap allocations and throughput per dispatched task: enqueue() with its
+// packaged_task and future, std::function batches, and inline post()/postBatch().
+// Each task carries a moved-in payload string like a datagram task does.
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/util/ThreadPool.h"
+#include "alloc_counter.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kTasks = 500000;
+constexpr size_t kBatch = 64;
+
+std::atomic<uint64_t> done{0};
+std::atomic<uint64_t> sink{0};
+
+void finish() {
+    done.fetch_add(1, std::memory_order_acq_rel);
+    done.notify_all();
+}
+
+void waitFor(uint64_t count) {
+    uint64_t seen;
+    while ((seen = done.load(std::memory_order_acquire)) < count) {
+        done.wait(seen);
+    }
+}
+
+// Payloads are built up front so only the dispatch itself is counted
+std::vector<std::string> makePayloads() {
+    std::vector<std::string> payloads;
+    payloads.reserve(kTasks);
+    for (size_t i = 0; i < kTasks; ++i) {
+        payloads.push_back("{\"command\":\"LOOKING_FOR\",\"rq\":" + std::to_string(i) + "}");
+    }
+    return payloads;
+}
+
+template <typename Submit>
+void run(const std::string& label, ThreadPool::Mode mode, Submit submit) {
+    auto payloads = makePayloads();
+    ThreadPool pool(4, mode);
+    done = 0;
+
+    // Let the queues grow to their working size before counting
+    submit(pool, payloads, kBatch);
+    waitFor(kBatch);
+    done = 0;
+    payloads = makePayloads();
+
+    uint64_t before = allocations.load();
+    auto start = Clock::now();
+    submit(pool, payloads, kTasks);
+    waitFor(kTasks);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t allocated = allocations.load() - before;
+
+    std::cout << std::left << std::setw(26) << label
+        << std::setw(10) << (mode == ThreadPool::Mode::WORK_STEALING ? "stealing" : "shared")
+        << std::right << std::setw(8) << std::fixed << std::setprecision(2)
+        << static_cast<double>(allocated) / kTasks << " allocs/task"
+        << std::setw(14) << std::setprecision(0) << kTasks / seconds << " tasks/s" << std::endl;
+}
+
+void runAll(ThreadPool::Mode mode) {
+    run("enqueue (future dropped)", mode, [](ThreadPool& pool, std::vector<std::string>& payloads, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            pool.enqueue([payload = std::move(payloads[i])] {
+                sink.fetch_add(payload.size(), std::memory_order_relaxed);
+                finish();
+            });
+        }
+    });
+
+    run("enqueueBatch (function)", mode, [](ThreadPool& pool, std::vector<std::string>& payloads, size_t count) {
+        for (size_t i = 0; i < count; i += kBatch) {
+            std::vector<std::function<void()>> batch;
+            batch.reserve(kBatch);
+            for (size_t j = i; j < i + kBatch && j < count; ++j) {
+                batch.emplace_back([payload = std::move(payloads[j])] {
+                    sink.fetch_add(payload.size(), std::memory_order_relaxed);
+                    finish();
+                });
+            }
+            pool.enqueueBatch(std::move(batch));
+        }
+    });
+
+    run("post", mode, [](ThreadPool& pool, std::vector<std::string>& payloads, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            pool.post([payload = std::move(payloads[i])] {
+                sink.fetch_add(payload.size(), std::memory_order_relaxed);
+                finish();
+            });
+        }
+    });
+
+    std::vector<ThreadPool::Task> batch;
+    batch.reserve(kBatch);
+    run("postBatch", mode, [&batch](ThreadPool& pool, std::vector<std::string>& payloads, size_t count) {
+        for (size_t i = 0; i < count; i += kBatch) {
+            for (size_t j = i; j < i + kBatch && j < count; ++j) {
+                batch.emplace_back([payload = std::move(payloads[j])] {
+                    sink.fetch_add(payload.size(), std::memory_order_relaxed);
+                    finish();
+                });
+            }
+            pool.postBatch(batch);
+        }
+    });
+}
+}
+
+int main() {
+    std::cout << kTasks << " tasks, 4 workers\n" << std::endl;
+    runAll(ThreadPool::Mode::SHARED_QUEUE);
+    runAll(ThreadPool::Mode::WORK_STEALING);
+    std::cout << "\n(sink " << sink.load() << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Small-task throughput of the shared-queue pool against work stealing, for
+// tasks fed from outside the pool and for tasks that spawn more tasks.
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/util/ThreadPool.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr uint64_t kExternalTasks = 1000000;
+constexpr size_t kExternalBatch = 64;
+// A binary tree of this depth spawns 2^20 - 1 tasks
+constexpr unsigned kFanOutDepth = 19;
+
+struct Completion {
+    std::atomic<uint64_t> done{0};
+    uint64_t total;
+
+    void finishOne() {
+        if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == total) {
+            done.notify_all();
+        }
+    }
+
+    void wait() {
+        uint64_t seen;
+        while ((seen = done.load(std::memory_order_acquire)) < total) {
+            done.wait(seen);
+        }
+    }
+};
+
+uint64_t work(uint64_t seed) {
+    // A few dozen cycles, about the size of a routing decision
+    for (int i = 0; i < 16; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return seed;
+}
+
+std::atomic<uint64_t> sink{0};
+
+void spawn(ThreadPool& pool, Completion& completion, unsigned depth) {
+    sink.fetch_add(work(depth) & 1, std::memory_order_relaxed);
+    if (depth > 0) {
+        std::vector<std::function<void()>> children;
+        children.emplace_back([&pool, &completion, depth] { spawn(pool, completion, depth - 1); });
+        children.emplace_back([&pool, &completion, depth] { spawn(pool, completion, depth - 1); });
+        pool.enqueueBatch(std::move(children));
+    }
+    completion.finishOne();
+}
+
+void report(const std::string& scenario, ThreadPool& pool, size_t threads, uint64_t tasks, double seconds) {
+    uint64_t steals = 0;
+    uint64_t idle = 0;
+    for (const auto& stats : pool.getWorkerStats()) {
+        steals += stats.steals;
+        idle += stats.idle;
+    }
+    std::cout << std::left << std::setw(10) << scenario
+        << std::setw(10) << (pool.getMode() == ThreadPool::Mode::WORK_STEALING ? "stealing" : "shared")
+        << std::right << std::setw(3) << threads << " threads"
+        << std::setw(14) << std::fixed << std::setprecision(0) << tasks / seconds << " tasks/s"
+        << std::setw(10) << steals << " steals" << std::setw(9) << idle << " idle" << std::endl;
+}
+
+void runExternal(ThreadPool::Mode mode, size_t threads) {
+    ThreadPool pool(threads, mode);
+    Completion completion;
+    completion.total = kExternalTasks;
+
+    auto start = Clock::now();
+    for (uint64_t sent = 0; sent < kExternalTasks; sent += kExternalBatch) {
+        std::vector<std::function<void()>> batch;
+        batch.reserve(kExternalBatch);
+        for (uint64_t i = sent; i < sent + kExternalBatch && i < kExternalTasks; ++i) {
+            batch.emplace_back([&completion, i] {
+                sink.fetch_add(work(i) & 1, std::memory_order_relaxed);
+                completion.finishOne();
+            });
+        }
+        pool.enqueueBatch(std::move(batch));
+    }
+    completion.wait();
+    report("external", pool, threads, kExternalTasks, std::chrono::duration<double>(Clock::now() - start).count());
+}
+
+void runFanOut(ThreadPool::Mode mode, size_t threads) {
+    ThreadPool pool(threads, mode);
+    Completion completion;
+    completion.total = (uint64_t(1) << (kFanOutDepth + 1)) - 1;
+
+    auto start = Clock::now();
+    pool.enqueueBatch({[&pool, &completion] { spawn(pool, completion, kFanOutDepth); }});
+    completion.wait();
+    report("fan-out", pool, threads, completion.total, std::chrono::duration<double>(Clock::now() - start).count());
+}
+}
+
+int main() {
+    for (size_t threads : {2, 4, 8}) {
+        for (auto mode : {ThreadPool::Mode::SHARED_QUEUE, ThreadPool::Mode::WORK_STEALING}) {
+            runExternal(mode, threads);
+        }
+        for (auto mode : {ThreadPool::Mode::SHARED_QUEUE, ThreadPool::Mode::WORK_STEALING}) {
+            runFanOut(mode, threads);
+        }
+    }
+    std::cout << "\n(sink " << sink.load() << ")" << std::endl;
+    return 0;
+}
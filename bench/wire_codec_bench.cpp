@@ -0,0 +1,72 @@
+// Bytes per message and encode/decode cost of each wire encoding, per command type.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/util/WireCodec.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr int kIterations = 200000;
+
+std::vector<std::pair<std::string, json>> sampleMessages() {
+    return {
+        {"REGISTER", {{"command", "REGISTER"}, {"rq", 1}, {"name", "peer1"}, {"ip", "192.168.1.20"},
+                      {"udp_port", 5000}, {"tcp_port", 5001}}},
+        {"REGISTERED", {{"command", "REGISTERED"}, {"rq", 1}, {"encoding", "msgpack"}}},
+        {"DE_REGISTER", {{"command", "DE_REGISTER"}, {"rq", 2}, {"name", "peer1"}}},
+        {"LOOKING_FOR", {{"command", "LOOKING_FOR"}, {"rq", 3}, {"name", "peer1"}, {"item_name", "laptop"},
+                         {"description", "14 inch, 16GB RAM"}, {"max_price", 899.99}}},
+        {"SEARCH", {{"command", "SEARCH"}, {"rq", 3}, {"item_name", "laptop"},
+                    {"description", "14 inch, 16GB RAM"}}},
+        {"OFFER", {{"command", "OFFER"}, {"rq", 3}, {"name", "peer2"}, {"item_name", "laptop"}, {"price", 850.0}}},
+        {"FOUND", {{"command", "FOUND"}, {"rq", 3}, {"item_name", "laptop"}, {"price", 850.0}}},
+        {"NOT_AVAILABLE", {{"command", "NOT_AVAILABLE"}, {"rq", 3}, {"item_name", "laptop"}, {"price", 899.99}}},
+        {"NEGOTIATE", {{"command", "NEGOTIATE"}, {"rq", 3}, {"item_name", "laptop"}, {"max_price", 899.99}}},
+    };
+}
+
+template <typename F>
+double nanosPerOp(F&& f) {
+    auto start = Clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        f();
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / kIterations;
+}
+}
+
+int main() {
+    const WireEncoding encodings[] = {WireEncoding::JSON, WireEncoding::MSGPACK, WireEncoding::CBOR};
+
+    std::cout << std::left << std::setw(15) << "command" << std::setw(9) << "encoding"
+        << std::right << std::setw(7) << "bytes" << std::setw(12) << "encode ns" << std::setw(12) << "decode ns"
+        << std::endl;
+
+    size_t checksum = 0;
+    for (const auto& [command, message] : sampleMessages()) {
+        for (WireEncoding encoding : encodings) {
+            std::string payload = WireCodec::encode(message, encoding);
+            if (WireCodec::decode(payload) != message) {
+                std::cerr << "Round trip mismatch for " << command << std::endl;
+                return 1;
+            }
+
+            double encode_ns = nanosPerOp([&] { checksum += WireCodec::encode(message, encoding).size(); });
+            double decode_ns = nanosPerOp([&] { checksum += WireCodec::decode(payload).size(); });
+
+            std::cout << std::left << std::setw(15) << command << std::setw(9) << WireCodec::encodingName(encoding)
+                << std::right << std::setw(7) << payload.size()
+                << std::setw(12) << std::fixed << std::setprecision(1) << encode_ns
+                << std::setw(12) << decode_ns << std::endl;
+        }
+    }
+
+    std::cout << "\n(checksum " << checksum << ")" << std::endl;
+    return 0;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include "../util/Event.h"
 
@@ -23,6 +25,11 @@ enum class P2PEventType {
     CANCEL,
     BUY,
     SHIPPED,
+    ADD_ITEM,
+    REMOVE_ITEM,
+    ADD_ITEMS,
+    INVENTORY_CHECK,
+    INVENTORY_RESYNC,
     UNKNOWN
 };
 
@@ -38,7 +45,16 @@ public:
         std::string item_description;
         double price;
         double max_price;
+        bool fuzzy; // LOOKING_FOR / SEARCH: match item names by prefix and small typos
+        double good_price; // LOOKING_FOR: close the search at the first offer this cheap (0 = off)
+        int expected_offers; // LOOKING_FOR: close after this many sellers answered (0 = all exact-name sellers)
         std::string reason;
+        std::string encoding; // Wire encoding requested at REGISTER / granted in REGISTERED
+        std::vector<std::string> inventory; // Item names published at REGISTER or in ADD_ITEMS
+        bool inventory_published;
+        int generation; // ADD_ITEMS: chunks of one full upload share it, a newer one replaces the last
+        uint64_t inventory_digest; // INVENTORY_CHECK: ItemMatch::fingerprint summed over listed names
+        size_t inventory_count; // INVENTORY_CHECK: distinct listed names
 
         MessageData(int rq, const std::string& name = "")
             : request_number(rq)
@@ -46,16 +62,53 @@ public:
               , udp_port(0)
               , tcp_port(0)
               , price(0.0)
-              , max_price(0.0) {
+              , max_price(0.0)
+              , fuzzy(false)
+              , good_price(0.0)
+              , expected_offers(0)
+              , inventory_published(false)
+              , generation(0)
+              , inventory_digest(0)
+              , inventory_count(0) {
+        }
+
+        // Back to a fresh state for a new message; cleared strings keep their capacity
+        void reset(int rq) {
+            request_number = rq;
+            sender_name.clear();
+            ip_address.clear();
+            udp_port = 0;
+            tcp_port = 0;
+            item_name.clear();
+            item_description.clear();
+            price = 0.0;
+            max_price = 0.0;
+            fuzzy = false;
+            good_price = 0.0;
+            expected_offers = 0;
+            reason.clear();
+            encoding.clear();
+            inventory.clear();
+            inventory_published = false;
+            generation = 0;
+            inventory_digest = 0;
+            inventory_count = 0;
         }
     };
 
     P2PEvent(P2PEventType type, MessageData data)
-        : type_(type), data_(data) {
+        : type_(type), data_(std::move(data)) {
     }
 
     P2PEventType getType() const { return type_; }
     const MessageData& getData() const { return data_; }
+    // For filling a pooled event in place
+    MessageData& getMutableData() { return data_; }
+
+    void reset(P2PEventType type, int rq) {
+        type_ = type;
+        data_.reset(rq);
+    }
 
     std::string getName() const override {
         switch (type_) {
@@ -76,6 +129,11 @@ public:
         case P2PEventType::CANCEL: return "CANCEL";
         case P2PEventType::BUY: return "BUY";
         case P2PEventType::SHIPPED: return "SHIPPED";
+        case P2PEventType::ADD_ITEM: return "ADD_ITEM";
+        case P2PEventType::REMOVE_ITEM: return "REMOVE_ITEM";
+        case P2PEventType::ADD_ITEMS: return "ADD_ITEMS";
+        case P2PEventType::INVENTORY_CHECK: return "INVENTORY_CHECK";
+        case P2PEventType::INVENTORY_RESYNC: return "INVENTORY_RESYNC";
         default: return "UNKNOWN";
         }
     }
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "P2PEvent.h"
+
+// Recycles P2PEvent objects instead of allocating one per message. Each thread
+// keeps a small free list; events released on another thread (the partition
+// threads consume what the workers parse) spill over to a shared depot in
+// batches, where acquiring threads pick them up again. A recycled event keeps
+// the capacity of its strings, so refilling it usually allocates nothing.
+class P2PEventPool {
+public:
+    struct Recycler {
+        void operator()(P2PEvent* event) const noexcept { release(event); }
+    };
+
+    using Handle = std::unique_ptr<P2PEvent, Recycler>;
+
+    struct Stats {
+        uint64_t created;
+        uint64_t reused;
+        size_t depot_size;
+    };
+
+    // A cleared event of the given type, ready to be filled in place
+    static Handle acquire(P2PEventType type, int request_number) {
+        Cache& cache = localCache();
+        if (cache.events.empty()) {
+            refill(cache);
+        }
+
+        P2PEvent* event;
+        if (cache.events.empty()) {
+            event = new P2PEvent(type, P2PEvent::MessageData{request_number});
+            created_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            event = cache.events.back();
+            cache.events.pop_back();
+            event->reset(type, request_number);
+            reused_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return Handle(event);
+    }
+
+    static Stats getStats() {
+        Depot& pool = depot();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        return {
+            created_.load(std::memory_order_relaxed),
+            reused_.load(std::memory_order_relaxed),
+            pool.events.size()
+        };
+    }
+
+private:
+    // Events moved between a thread cache and the depot at a time
+    static constexpr size_t kTransferBatch = 64;
+    static constexpr size_t kMaxCached = 2 * kTransferBatch;
+    // Beyond this the depot frees events rather than hoarding a burst forever
+    static constexpr size_t kMaxDepot = 16384;
+
+    struct Depot {
+        std::mutex mutex;
+        std::vector<P2PEvent*> events;
+
+        // Reserved up front so spilling never allocates
+        Depot() { events.reserve(kMaxDepot); }
+
+        ~Depot() {
+            for (P2PEvent* event : events) {
+                delete event;
+            }
+        }
+    };
+
+    struct Cache {
+        std::vector<P2PEvent*> events;
+
+        Cache() { events.reserve(kMaxCached); }
+
+        ~Cache() {
+            spill(*this, events.size());
+        }
+    };
+
+    static inline std::atomic<uint64_t> created_{0};
+    static inline std::atomic<uint64_t> reused_{0};
+
+    static Depot& depot() {
+        static Depot pool;
+        return pool;
+    }
+
+    static Cache& localCache() {
+        thread_local Cache cache;
+        return cache;
+    }
+
+    static void release(P2PEvent* event) noexcept {
+        Cache& cache = localCache();
+        if (cache.events.size() == kMaxCached) {
+            spill(cache, kTransferBatch);
+        }
+        cache.events.push_back(event);
+    }
+
+    static void refill(Cache& cache) {
+        Depot& pool = depot();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        size_t take = std::min(kTransferBatch, pool.events.size());
+        cache.events.insert(cache.events.end(), pool.events.end() - take, pool.events.end());
+        pool.events.resize(pool.events.size() - take);
+    }
+
+    static void spill(Cache& cache, size_t count) noexcept {
+        auto first = cache.events.end() - count;
+        {
+            Depot& pool = depot();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            while (first != cache.events.end() && pool.events.size() < kMaxDepot) {
+                pool.events.push_back(*first++);
+            }
+        }
+        for (auto it = first; it != cache.events.end(); ++it) {
+            delete *it;
+        }
+        cache.events.resize(cache.events.size() - count);
+    }
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <memory>
 #include <string>
 
 #include "../util/State.h"
@@ -23,6 +25,18 @@ public:
 
     P2PStateType getType() const { return type_; }
 
+    // One preallocated instance per state, shared instead of allocating per transition
+    static const std::shared_ptr<P2PState>& get(P2PStateType type) {
+        static const auto interned = [] {
+            std::array<std::shared_ptr<P2PState>, static_cast<size_t>(P2PStateType::ERROR) + 1> states;
+            for (size_t i = 0; i < states.size(); ++i) {
+                states[i] = std::make_shared<P2PState>(static_cast<P2PStateType>(i));
+            }
+            return states;
+        }();
+        return interned[static_cast<size_t>(type)];
+    }
+
     std::string getName() const override {
         switch (type_) {
         case P2PStateType::UNREGISTERED: return "UNREGISTERED";
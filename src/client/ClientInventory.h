@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../util/ItemMatch.h"
+#include "../util/ItemNameIndex.h"
+
+// A seller's stock hashed by normalized name. Each name keeps its listings
+// cheapest first, and restocking a listing with the same spelling, description
+// and price only raises its quantity. Fuzzy lookups go through the same
+// trie/trigram index the server uses, so no lookup scans the whole stock.
+class ClientInventory {
+public:
+    struct Listing {
+        std::string name;
+        std::string description;
+        double price;
+        int quantity;
+    };
+
+    struct Change {
+        bool applied;
+        // The exact spelling was newly listed, or has no listing left
+        bool spelling_changed;
+    };
+
+    Change add(const std::string& name, const std::string& description, double price, int quantity = 1) {
+        if (quantity <= 0) {
+            return {false, false};
+        }
+
+        auto [it, inserted] = listings_.try_emplace(ItemMatch::normalize(name));
+        auto& listings = it->second;
+        if (inserted) {
+            names_.insert(it->first);
+        }
+        bool spelling_listed = hasSpelling(listings, name);
+
+        auto same = std::find_if(listings.begin(), listings.end(), [&](const Listing& listing) {
+            return listing.name == name && listing.description == description && listing.price == price;
+        });
+        if (same != listings.end()) {
+            same->quantity += quantity;
+        }
+        else {
+            auto at = std::upper_bound(listings.begin(), listings.end(), price,
+                                       [](double p, const Listing& listing) { return p < listing.price; });
+            listings.insert(at, {name, description, price, quantity});
+            ++listing_count_;
+        }
+        if (!spelling_listed) {
+            ++spelling_count_;
+            digest_ += ItemMatch::fingerprint(name);
+        }
+        return {true, !spelling_listed};
+    }
+
+    // Drops the cheapest listing with this spelling, whatever its quantity
+    Change remove(const std::string& name) {
+        return withCheapest(name, [](Listing&) { return true; });
+    }
+
+    // Hands one unit of the cheapest listing with this spelling to a buyer
+    Change take(const std::string& name) {
+        return withCheapest(name, [](Listing& listing) { return --listing.quantity == 0; });
+    }
+
+    // Cheapest listing under the name, ignoring case
+    const Listing* cheapest(const std::string& name) const {
+        auto it = listings_.find(ItemMatch::normalize(name));
+        return it != listings_.end() ? &it->second.front() : nullptr;
+    }
+
+    // Cheapest listing among the names closest to the query
+    const Listing* closest(const std::string& query) const {
+        const Listing* best = nullptr;
+        size_t best_distance = 0;
+        for (const auto& match : names_.fuzzyMatches(query, kFuzzyCandidates)) {
+            if (best && match.distance > best_distance) {
+                break;
+            }
+            auto it = listings_.find(match.name);
+            if (it == listings_.end()) {
+                continue;
+            }
+            const Listing& candidate = it->second.front();
+            if (!best || candidate.price < best->price) {
+                best = &candidate;
+                best_distance = match.distance;
+            }
+        }
+        return best;
+    }
+
+    // Whether this exact spelling is listed, which is what the server indexes
+    bool contains(const std::string& name) const {
+        auto it = listings_.find(ItemMatch::normalize(name));
+        return it != listings_.end() && hasSpelling(it->second, name);
+    }
+
+    // Distinct listed spellings. Spellings of different keys never collide,
+    // so duplicates are only looked for among the current key's few listings.
+    std::vector<std::string> spellings() const {
+        std::vector<std::string> names;
+        names.reserve(spelling_count_);
+        for (const auto& [key, listings] : listings_) {
+            auto bucket_start = static_cast<std::ptrdiff_t>(names.size());
+            for (const auto& listing : listings) {
+                if (std::find(names.begin() + bucket_start, names.end(), listing.name) == names.end()) {
+                    names.push_back(listing.name);
+                }
+            }
+        }
+        return names;
+    }
+
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        for (const auto& [key, listings] : listings_) {
+            for (const auto& listing : listings) {
+                visit(listing);
+            }
+        }
+    }
+
+    bool empty() const { return listing_count_ == 0; }
+    size_t size() const { return listing_count_; }
+
+    // What the server should have indexed for us: the number of distinct
+    // spellings and their fingerprints summed, see InventoryIndex::inSync
+    size_t spellingCount() const { return spelling_count_; }
+    uint64_t digest() const { return digest_; }
+
+private:
+    // Names a fuzzy lookup ranks by price before settling on one
+    static constexpr size_t kFuzzyCandidates = 8;
+
+    std::unordered_map<std::string, std::vector<Listing>> listings_;
+    // Indexed by normalized name, one entry per key of listings_
+    ItemNameIndex names_;
+    size_t listing_count_ = 0;
+    size_t spelling_count_ = 0;
+    uint64_t digest_ = 0;
+
+    static bool hasSpelling(const std::vector<Listing>& listings, const std::string& name) {
+        return std::any_of(listings.begin(), listings.end(),
+                           [&name](const Listing& listing) { return listing.name == name; });
+    }
+
+    // Applies update to the cheapest listing with this spelling and drops
+    // the listing when update says it is used up
+    template <typename Update>
+    Change withCheapest(const std::string& name, Update update) {
+        auto it = listings_.find(ItemMatch::normalize(name));
+        if (it == listings_.end()) {
+            return {false, false};
+        }
+        auto& listings = it->second;
+        auto listing = std::find_if(listings.begin(), listings.end(),
+                                    [&name](const Listing& l) { return l.name == name; });
+        if (listing == listings.end()) {
+            return {false, false};
+        }
+        if (!update(*listing)) {
+            return {true, false};
+        }
+
+        listings.erase(listing);
+        --listing_count_;
+        bool unlisted = !hasSpelling(listings, name);
+        if (unlisted) {
+            --spelling_count_;
+            digest_ -= ItemMatch::fingerprint(name);
+        }
+        if (listings.empty()) {
+            names_.erase(it->first);
+            listings_.erase(it);
+        }
+        return {true, unlisted};
+    }
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../util/Logger.h"
+
+// The IPv4 address this client advertises to the server. It is read from
+// getifaddrs once and then only again after the kernel reports a link or
+// address change on a netlink socket, so registering never waits on DNS.
+class LocalAddress {
+public:
+    // An empty interface name picks the first non-loopback interface that is up
+    explicit LocalAddress(std::string interface_name = "")
+        : interface_name_(std::move(interface_name)) {
+        openNotifySocket();
+        refresh();
+    }
+
+    ~LocalAddress() {
+        if (notify_fd_ >= 0) { close(notify_fd_); }
+    }
+
+    LocalAddress(const LocalAddress&) = delete;
+    LocalAddress& operator=(const LocalAddress&) = delete;
+
+    // Readable when the network changed; -1 if netlink is unavailable
+    int getNotifyFd() const { return notify_fd_; }
+
+    // Without netlink there is no change signal, so every lookup re-reads
+    // the interfaces. That is still a syscall, not a resolver round trip.
+    const std::string& get() {
+        if (notify_fd_ < 0) { refresh(); }
+        return address_;
+    }
+
+    const std::string& getInterfaceName() const { return interface_name_; }
+
+    // Drain the pending notifications and re-read the interfaces once
+    void handleNotification() {
+        char buffer[8192];
+        bool changed = false;
+        while (recv(notify_fd_, buffer, sizeof(buffer), 0) > 0) { changed = true; }
+        if (changed) { refresh(); }
+    }
+
+    void refresh() {
+        ifaddrs* interfaces = nullptr;
+        if (getifaddrs(&interfaces) < 0) {
+            P2P_LOG_WARN("getifaddrs failed: " << std::strerror(errno));
+            return;
+        }
+
+        std::string found;
+        for (ifaddrs* ifa = interfaces; ifa && found.empty(); ifa = ifa->ifa_next) {
+            if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET) { continue; }
+            if (!(ifa->ifa_flags & IFF_UP)) { continue; }
+            if (interface_name_.empty() ? (ifa->ifa_flags & IFF_LOOPBACK) != 0 : interface_name_ != ifa->ifa_name) {
+                continue;
+            }
+
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(ifa->ifa_addr)->sin_addr, ip, sizeof(ip));
+            found = ip;
+        }
+        freeifaddrs(interfaces);
+
+        if (found.empty()) {
+            if (!interface_name_.empty()) {
+                P2P_LOG_WARN("Interface " << interface_name_ << " has no IPv4 address, using 127.0.0.1");
+            }
+            found = "127.0.0.1";
+        }
+        if (found != address_) {
+            P2P_LOG_DEBUG("Local address is now " << found);
+            address_ = std::move(found);
+        }
+    }
+
+private:
+    std::string interface_name_;
+    std::string address_ = "127.0.0.1";
+    int notify_fd_ = -1;
+
+    void openNotifySocket() {
+        notify_fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (notify_fd_ < 0) {
+            P2P_LOG_WARN("netlink unavailable, local address is re-read on every registration");
+            return;
+        }
+
+        sockaddr_nl addr{};
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+        if (bind(notify_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            P2P_LOG_WARN("netlink bind failed, local address is re-read on every registration");
+            close(notify_fd_);
+            notify_fd_ = -1;
+        }
+    }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Offers a buyer has received, keyed by the request they answer. Every offer
+// lives for the same TTL, so deadlines arrive in insertion order and a FIFO
+// of them is all the expiry bookkeeping needed: the owner arms one timer for
+// the front and calls expire() when it fires. Offers taken before their
+// deadline leave a stale FIFO entry behind that expire() simply skips.
+class OfferBook {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Offer {
+        std::string item_name;
+        double price;
+        Clock::time_point expires;
+    };
+
+    enum class TakeResult {
+        TAKEN,
+        NO_OFFER,
+        MISMATCH
+    };
+
+    explicit OfferBook(Clock::duration ttl) : ttl_(ttl) {
+    }
+
+    void add(int request_number, const std::string& item_name, double price, Clock::time_point now = Clock::now()) {
+        Clock::time_point expires = now + ttl_;
+        offers_[request_number].push_back({item_name, price, expires});
+        deadlines_.push_back({expires, request_number});
+        ++size_;
+    }
+
+    // Removes the request's first offer for item_name, and at that price if
+    // one is given
+    TakeResult take(int request_number, const std::string& item_name, std::optional<double> price = std::nullopt) {
+        auto it = offers_.find(request_number);
+        if (it == offers_.end()) {
+            return TakeResult::NO_OFFER;
+        }
+
+        auto& offers = it->second;
+        for (auto offer = offers.begin(); offer != offers.end(); ++offer) {
+            if (offer->item_name == item_name && (!price || offer->price == *price)) {
+                offers.erase(offer);
+                --size_;
+                if (offers.empty()) {
+                    offers_.erase(it);
+                }
+                return TakeResult::TAKEN;
+            }
+        }
+        return TakeResult::MISMATCH;
+    }
+
+    // Drops every offer whose deadline has passed; returns how many went
+    size_t expire(Clock::time_point now = Clock::now()) {
+        size_t expired = 0;
+        while (!deadlines_.empty() && deadlines_.front().expires <= now) {
+            auto it = offers_.find(deadlines_.front().request_number);
+            deadlines_.pop_front();
+            if (it == offers_.end()) {
+                continue;
+            }
+
+            // A request's offers were added in deadline order too
+            auto& offers = it->second;
+            size_t due = 0;
+            while (due < offers.size() && offers[due].expires <= now) {
+                ++due;
+            }
+            offers.erase(offers.begin(), offers.begin() + due);
+            expired += due;
+            if (offers.empty()) {
+                offers_.erase(it);
+            }
+        }
+        size_ -= expired;
+        return expired;
+    }
+
+    // When the timer should next fire, if anything is pending
+    std::optional<Clock::time_point> nextExpiry() const {
+        if (deadlines_.empty()) {
+            return std::nullopt;
+        }
+        return deadlines_.front().expires;
+    }
+
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        for (const auto& [request_number, offers] : offers_) {
+            for (const auto& offer : offers) {
+                visit(request_number, offer);
+            }
+        }
+    }
+
+    size_t size() const { return size_; }
+
+    Clock::duration getTtl() const { return ttl_; }
+
+private:
+    struct Deadline {
+        Clock::time_point expires;
+        int request_number;
+    };
+
+    Clock::duration ttl_;
+    std::unordered_map<int, std::vector<Offer>> offers_;
+    std::deque<Deadline> deadlines_;
+    size_t size_ = 0;
+};
@@ -1,24 +1,41 @@
 #include "client.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <fcntl.h>
 #include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
 P2PClient::~P2PClient() {
     stop();
     close(client_socket_);
+    close(epoll_fd_);
+    close(command_fd_);
+    close(stop_fd_);
+    close(offer_timer_fd_);
+    close(inventory_timer_fd_);
+    close(search_timer_fd_);
 }
 
 void P2PClient::start() {
     running_ = true;
-    receive_thread_ = std::thread(&P2PClient::receiveMessages, this);
+    loop_thread_ = std::thread(&P2PClient::runEventLoop, this);
     startCommandLoop();
+    stop();
 }
 
 void P2PClient::stop() {
     running_ = false;
-    if (receive_thread_.joinable()) { receive_thread_.join(); }
+    signalEventFd(stop_fd_);
+    if (loop_thread_.joinable()) { loop_thread_.join(); }
 }
 
+// Reads stdin on the calling thread; everything that touches client state is
+// posted to the event loop
 void P2PClient::startCommandLoop() {
     printHelp();
 
@@ -31,6 +48,11 @@ void P2PClient::startCommandLoop() {
     }
 }
 
+void P2PClient::post(std::function<void()> command) {
+    commands_.push(std::move(command));
+    signalEventFd(command_fd_);
+}
+
 void P2PClient::processUserCommand(const std::string& command) {
     std::istringstream iss(command);
     std::string cmd;
@@ -51,25 +73,32 @@ void P2PClient::processUserCommand(const std::string& command) {
 
         iss >> price;
 
-        addItem(name, description, price);
+        int quantity = 1;
+        if (!(iss >> quantity)) { quantity = 1; }
+
+        post([=, this] { addItem(name, description, price, quantity); });
     }
-    else if (cmd == "remove" | cmd == "rm") {
+    else if (cmd == "remove" || cmd == "rm") {
         std::string name;
         iss >> name;
-        removeItem(name);
+        post([this, name] { removeItem(name); });
     }
-    else if (cmd == "list" || cmd == "ls") { listInventory(); }
+    else if (cmd == "list" || cmd == "ls") { post([this] { listInventory(); }); }
     else if (cmd == "help" || cmd == "h") { printHelp(); }
-    else if (cmd == "register" || cmd == "r") { registerWithServer(); }
-    else if (cmd == "deregister" || cmd == "d") { deregister(); }
+    else if (cmd == "register" || cmd == "r") { post([this] { registerWithServer(); }); }
+    else if (cmd == "deregister" || cmd == "d") { post([this] { deregister(); }); }
     else if (cmd == "search" || cmd == "s") { handleSearchCommand(iss); }
     else if (cmd == "listOffers" || cmd == "ls offers" ) { handleListOffersCommand(iss); }
     else if (cmd == "negotiate" || cmd == "n") { handleNegotiateCommand(iss); }
     else if (cmd == "accept" || cmd == "a") { handleAcceptCommand(iss); }
     else if (cmd == "refuse" || cmd == "f") { handleRefuseCommand(iss); }
-    else if (cmd == "status") { printStatus(); }
+    else if (cmd == "server") { handleServerCommand(iss); }
+    else if (cmd == "status") { post([this] { printStatus(); }); }
     else if (cmd == "quit" || cmd == "q") {
-        if (current_state_ == P2PStateType::REGISTERED) { deregister(); }
+        // Runs before the loop exits, it drains the queue on stop
+        post([this] {
+            if (current_state_ == P2PStateType::REGISTERED) { deregister(); }
+        });
         running_ = false;
     }
     else {
@@ -81,13 +110,14 @@ void P2PClient::printHelp() {
     std::cout << "\n=== P2P Client Commands ===" << std::endl;
     std::cout << "register  (r) - Register with the server" << std::endl;
     std::cout << "deregister(d) - Deregister from the server" << std::endl;
-    std::cout << "search    (s) <item_name> <description> <max_price> - Search for an item" << std::endl;
+    std::cout << "search    (s) <item_name> <description> <max_price> [fuzzy] [good=<price>] [offers=<n>] - Search for an item" << std::endl;
     std::cout << "listOffers(ls offers) - List active offers" << std::endl;
     std::cout << "negotiate (n) <request_number> <item_name> <counter_price> - Negotiate an offer" << std::endl;
     std::cout << "accept    (a) <request_number> <item_name> <price> - Accept an offer" << std::endl;
     std::cout << "refuse    (f) <request_number> <item_name> <price> - Refuse an offer" << std::endl;
+    std::cout << "server        <ip> <port> - Switch to another server" << std::endl;
     std::cout << "status        - Show current client status" << std::endl;
-    std::cout << "add       <name> <description> <price> - Add item to inventory" << std::endl;
+    std::cout << "add       <name> <description> <price> [quantity] - Add item to inventory" << std::endl;
     std::cout << "remove    (rm) <name> - Remove item from inventory" << std::endl;
     std::cout << "list      (ls)- List all items in inventory" << std::endl;
     std::cout << "help      (h) - Show this help message" << std::endl;
@@ -98,8 +128,14 @@ void P2PClient::printHelp() {
 void P2PClient::printStatus() {
     std::cout << "\n=== Client Status ===" << std::endl;
     std::cout << "Name: " << name_ << std::endl;
-    std::cout << "Server: " << server_ip_ << ":" << server_port_ << std::endl;
+    std::cout << "Server: " << server_ip_ << ":" << server_port_
+              << (socket_connected_ ? " (connected)" : "") << std::endl;
     std::cout << "Current State: " << getStateName(current_state_) << std::endl;
+    std::cout << "Searches In Flight: " << searches_.size() << std::endl;
+    std::cout << "Offers Held: " << offers_.size() << std::endl;
+    std::cout << "Local Address: " << local_address_.get();
+    if (!local_address_.getInterfaceName().empty()) { std::cout << " (" << local_address_.getInterfaceName() << ")"; }
+    std::cout << std::endl;
     std::cout << "Local Port: " << getLocalPort() << std::endl;
     std::cout << "==================\n" << std::endl;
 }
@@ -124,19 +160,39 @@ void P2PClient::handleSearchCommand(std::istringstream& iss) {
 
     iss >> max_price;
 
-    searchItem(item_name, description, max_price);
+    // Optional: fuzzy, good=<price> to take the first offer that cheap, offers=<n> to stop after n
+    bool fuzzy = false;
+    double good_price = 0.0;
+    int expected_offers = 0;
+    std::string option;
+    while (iss >> option) {
+        if (option == "fuzzy") { fuzzy = true; }
+        else if (option.rfind("good=", 0) == 0) { good_price = std::stod(option.substr(5)); }
+        else if (option.rfind("offers=", 0) == 0) { expected_offers = std::stoi(option.substr(7)); }
+        else { std::cout << "Ignoring unknown search option: " << option << std::endl; }
+    }
+
+    post([=, this] { searchItem(item_name, description, max_price, fuzzy, good_price, expected_offers); });
 }
 
-void P2PClient::handleListOffersCommand(std::istringstream& iss) {
+void P2PClient::handleListOffersCommand(std::istringstream&) {
+    post([this] { listOffers(); });
+}
+
+void P2PClient::listOffers() {
+    offers_.expire();
 
     std::cout << "\n=== List of Offers ===" << std::endl;
-    for (const auto& offer : offers_) {
-        std::cout << "Request Number: " << offer.requestNumber << std::endl;
-        std::cout << "Name" << offer.name << std::endl;
-        std::cout << "Offered Price" << offer.price << std::endl;
+    auto now = OfferBook::Clock::now();
+    offers_.forEach([now](int request_number, const OfferBook::Offer& offer) {
+        auto left = std::chrono::duration_cast<std::chrono::seconds>(offer.expires - now);
+        std::cout << "Request Number: " << request_number << std::endl;
+        std::cout << "Name: " << offer.item_name << std::endl;
+        std::cout << "Offered Price: " << offer.price << std::endl;
+        std::cout << "Expires In: " << left.count() << "s" << std::endl;
 
         std::cout << std::endl;
-    }
+    });
 }
 
 void P2PClient::handleNegotiateCommand(std::istringstream&) {
@@ -155,7 +211,7 @@ void P2PClient::handleNegotiateCommand(std::istringstream&) {
     std::cin >> counter_price;
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
-    negotiateOffer(request_number, item_name, counter_price);
+    post([=, this] { negotiateOffer(request_number, item_name, counter_price); });
 }
 
 void P2PClient::handleAcceptCommand(std::istringstream&) {
@@ -174,7 +230,7 @@ void P2PClient::handleAcceptCommand(std::istringstream&) {
     std::cin >> price;
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
-    acceptOffer(request_number, item_name, price);
+    post([=, this] { acceptOffer(request_number, item_name, price); });
 }
 
 void P2PClient::handleRefuseCommand(std::istringstream&) {
@@ -193,7 +249,17 @@ void P2PClient::handleRefuseCommand(std::istringstream&) {
     std::cin >> price;
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
-    refuseOffer(request_number, item_name, price);
+    post([=, this] { refuseOffer(request_number, item_name, price); });
+}
+
+void P2PClient::handleServerCommand(std::istringstream& iss) {
+    std::string server_ip;
+    int server_port = 0;
+    if (!(iss >> server_ip >> server_port) || server_port <= 0 || server_port > 65535) {
+        std::cout << "Usage: server <ip> <port>" << std::endl;
+        return;
+    }
+    post([=, this] { setServerAddress(server_ip, static_cast<uint16_t>(server_port)); });
 }
 
 // Client operations
@@ -207,10 +273,20 @@ bool P2PClient::registerWithServer() {
         {"command", "REGISTER"},
         {"rq", getNextRequestNumber()},
         {"name", name_},
-        {"ip", getLocalIpAddress()},
+        {"ip", local_address_.get()},
         {"udp_port", udp_port_},
         {"tcp_port", tcp_port_}
     };
+    if (preferred_encoding_ != WireEncoding::JSON) {
+        register_msg["encoding"] = WireCodec::encodingName(preferred_encoding_);
+    }
+
+    // An empty inventory marks us as a publishing peer, so the server only
+    // sends us searches we can answer. The names follow in ADD_ITEMS chunks
+    // once REGISTERED arrives: a large stock does not fit in one datagram.
+    register_msg["inventory"] = json::array();
+
+    if (connected_udp_ && !connectToServer()) { return false; }
 
     logOutgoingMessage(register_msg);
     if (sendMessage(register_msg)) {
@@ -235,56 +311,85 @@ bool P2PClient::deregister() {
     logOutgoingMessage(deregister_msg);
     if (sendMessage(deregister_msg)) {
         current_state_ = P2PStateType::UNREGISTERED;
+        wire_encoding_ = WireEncoding::JSON;
+        searches_.clear();
+        search_deadlines_.clear();
+        armSearchTimer();
+        armInventoryTimer(false);
         return true;
     }
     return false;
 }
 
-bool P2PClient::searchItem(const std::string& item_name, const std::string& description, double max_price) {
+bool P2PClient::searchItem(const std::string& item_name, const std::string& description, double max_price,
+                           bool fuzzy, double good_price, int expected_offers) {
     if (current_state_ != P2PStateType::REGISTERED) {
         std::cout << "Not registered with server" << std::endl;
         return false;
     }
 
+    int request_number = getNextRequestNumber();
     json search_msg = {
         {"command", "LOOKING_FOR"},
-        {"rq", getNextRequestNumber()},
+        {"rq", request_number},
         {"name", name_},
         {"item_name", item_name},
         {"description", description},
         {"max_price", max_price}
     };
+    if (fuzzy) {
+        search_msg["fuzzy"] = true;
+    }
+    if (good_price > 0) {
+        search_msg["good_price"] = good_price;
+    }
+    if (expected_offers > 0) {
+        search_msg["expected_offers"] = expected_offers;
+    }
 
+    // The client stays REGISTERED: it keeps answering searches and can start
+    // more of its own while this one is out
     logOutgoingMessage(search_msg);
     if (sendMessage(search_msg)) {
-        current_state_ = P2PStateType::SEARCHING;
+        auto expires = std::chrono::steady_clock::now() + kSearchLifetime;
+        searches_[request_number] = {item_name, P2PStateType::SEARCHING, expires};
+        search_deadlines_.push_back({expires, request_number});
+        if (search_deadlines_.size() == 1) {
+            armSearchTimer();
+        }
+        std::cout << "Search #" << request_number << " sent for " << item_name
+            << " (" << searches_.size() << " in flight)" << std::endl;
         return true;
     }
     return false;
 }
 
-bool P2PClient::negotiateOffer(int request_number, const std::string& item_name, double counter_price) {
-    if (current_state_ != P2PStateType::SEARCHING && current_state_ != P2PStateType::NEGOTIATING) {
-        std::cout << "Not in a valid state for negotiation" << std::endl;
+bool P2PClient::takeOffer(int request_number, const std::string& item_name, std::optional<double> price) {
+    offers_.expire();
+    switch (offers_.take(request_number, item_name, price)) {
+    case OfferBook::TakeResult::TAKEN:
+        return true;
+    case OfferBook::TakeResult::NO_OFFER:
+        std::cout << "Offer not found for request number: " << request_number << std::endl;
+        return false;
+    case OfferBook::TakeResult::MISMATCH:
+        std::cout << (price ? "Item name and price do not match" : "Item name does not match request number") << std::endl;
         return false;
     }
+    return false;
+}
 
-    auto it = std::find_if(offers_.begin(), offers_.end(), [request_number](const Offer& offer) {
-        return offer.requestNumber == request_number;
-    });
-
-    if (it == offers_.end()) {
-        std::cout << "Offer not found for request number: " << request_number << std::endl;
+bool P2PClient::negotiateOffer(int request_number, const std::string& item_name, double counter_price) {
+    auto search = searches_.find(request_number);
+    if (search == searches_.end()) {
+        std::cout << "No search in flight with request number: " << request_number << std::endl;
         return false;
     }
 
-    if (it.base()->name != item_name) {
-        std::cout << "Item name does not match request number" << std::endl;
+    if (!takeOffer(request_number, item_name, std::nullopt)) {
         return false;
     }
 
-    offers_.erase(it);
-
     json negotiate_msg = {
         {"command", "NEGOTIATE"},
         {"rq", request_number},
@@ -295,29 +400,17 @@ bool P2PClient::negotiateOffer(int request_number, const std::string& item_name,
 
     logOutgoingMessage(negotiate_msg);
     if (sendMessage(negotiate_msg)) {
-        current_state_ = P2PStateType::NEGOTIATING;
+        search->second.state = P2PStateType::NEGOTIATING;
         return true;
     }
     return false;
 }
 
 bool P2PClient::acceptOffer(int request_number, const std::string& item_name, double price) {
-    auto it = std::find_if(offers_.begin(), offers_.end(), [request_number](const Offer& offer) {
-        return offer.requestNumber == request_number;
-    });
-
-    if (it == offers_.end()) {
-        std::cout << "Offer not found for request number: " << request_number << std::endl;
-        return false;
-    }
-
-    if (it.base()->name != item_name || it.base()->price != price) {
-        std::cout << "Item name and price do not match" << std::endl;
+    if (!takeOffer(request_number, item_name, price)) {
         return false;
     }
 
-    offers_.erase(it);
-
     json accept_msg = {
         {"command", "ACCEPT"},
         {"rq", request_number},
@@ -331,22 +424,10 @@ bool P2PClient::acceptOffer(int request_number, const std::string& item_name, do
 }
 
 bool P2PClient::refuseOffer(int request_number, const std::string& item_name, double price) {
-    auto it = std::find_if(offers_.begin(), offers_.end(), [request_number](const Offer& offer) {
-        return offer.requestNumber == request_number;
-    });
-
-    if (it == offers_.end()) {
-        std::cout << "Offer not found for request number: " << request_number << std::endl;
-        return false;
-    }
-
-    if (it.base()->name != item_name || it.base()->price != price) {
-        std::cout << "Item name and price do not match" << std::endl;
+    if (!takeOffer(request_number, item_name, price)) {
         return false;
     }
 
-    offers_.erase(it);
-
     json refuse_msg = {
         {"command", "REFUSE"},
         {"rq", request_number},
@@ -360,8 +441,7 @@ bool P2PClient::refuseOffer(int request_number, const std::string& item_name, do
 }
 
 void P2PClient::logOutgoingMessage(const json& msg) {
-    std::cout << "\n=== Sending Message ===" << std::endl;
-    MessageParser::printMessage(msg);
+    MessageParser::dumpMessage(msg, "Sending Message");
 }
 
 void P2PClient::setupSocket() {
@@ -382,22 +462,170 @@ void P2PClient::setupSocket() {
     // Set socket to non-blocking mode
     int flags = fcntl(client_socket_, F_GETFL, 0);
     fcntl(client_socket_, F_SETFL, flags | O_NONBLOCK);
+
+    if (!resolveServerAddress(server_ip_, server_port_, server_addr_)) {
+        close(client_socket_);
+        throw std::runtime_error("Invalid server address " + server_ip_);
+    }
+}
+
+void P2PClient::setupEventLoop() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    command_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    offer_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    inventory_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    search_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd_ < 0 || command_fd_ < 0 || stop_fd_ < 0 || offer_timer_fd_ < 0 || inventory_timer_fd_ < 0 ||
+        search_timer_fd_ < 0) {
+        throw std::runtime_error("Failed to create event loop descriptors");
+    }
+
+    for (int fd : {client_socket_, command_fd_, stop_fd_, offer_timer_fd_, inventory_timer_fd_,
+                   search_timer_fd_, local_address_.getNotifyFd()}) {
+        if (fd < 0) { continue; }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            throw std::runtime_error("Failed to add descriptor to epoll");
+        }
+    }
+}
+
+void P2PClient::signalEventFd(int fd) {
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        P2P_LOG_WARN("eventfd write failed: " << std::strerror(errno));
+    }
+}
+
+// The only thread that touches client state: datagrams are handled the
+// moment they arrive and CLI commands run between them
+void P2PClient::runEventLoop() {
+    epoll_event events[kMaxEvents];
+    bool stopping = false;
+
+    while (!stopping) {
+        int ready = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+        if (ready < 0) {
+            if (errno == EINTR) { continue; }
+            P2P_LOG_ERROR("epoll_wait failed: " << std::strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == client_socket_) {
+                receiveMessages();
+            }
+            else if (fd == command_fd_) {
+                uint64_t count;
+                while (read(command_fd_, &count, sizeof(count)) > 0) {}
+                runCommands();
+            }
+            else if (fd == stop_fd_) {
+                stopping = true;
+            }
+            else if (fd == offer_timer_fd_) {
+                expireOffers();
+            }
+            else if (fd == inventory_timer_fd_) {
+                checkInventory();
+            }
+            else if (fd == search_timer_fd_) {
+                expireSearches();
+            }
+            else if (fd == local_address_.getNotifyFd()) {
+                local_address_.handleNotification();
+            }
+        }
+    }
+
+    // Commands posted before the stop still run, quit's deregister among them
+    runCommands();
+}
+
+// steady_clock is CLOCK_MONOTONIC, so the deadline converts to the timer directly
+void P2PClient::setTimer(int timer_fd, std::optional<std::chrono::steady_clock::time_point> deadline) {
+    itimerspec spec{};
+    if (deadline) {
+        auto wait = std::max<std::chrono::steady_clock::duration>(*deadline - std::chrono::steady_clock::now(),
+                                                                  std::chrono::nanoseconds(1));
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(wait);
+        spec.it_value.tv_sec = seconds.count();
+        spec.it_value.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(wait - seconds).count();
+    }
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+void P2PClient::armOfferTimer() {
+    std::optional<OfferBook::Clock::time_point> next = offers_.nextExpiry();
+    setTimer(offer_timer_fd_, next);
+    offer_timer_armed_ = next.has_value();
+}
+
+void P2PClient::armSearchTimer() {
+    setTimer(search_timer_fd_, search_deadlines_.empty()
+                                   ? std::nullopt
+                                   : std::optional(search_deadlines_.front().expires));
+}
+
+void P2PClient::expireSearches() {
+    uint64_t expirations;
+    while (read(search_timer_fd_, &expirations, sizeof(expirations)) > 0) {}
+
+    auto now = std::chrono::steady_clock::now();
+    while (!search_deadlines_.empty() && search_deadlines_.front().expires <= now) {
+        auto search = searches_.find(search_deadlines_.front().request_number);
+        search_deadlines_.pop_front();
+        if (search == searches_.end() || search->second.expires > now) {
+            continue;
+        }
+        std::cout << "Search #" << search->first << " for " << search->second.item_name
+            << ": no answer from the server" << std::endl;
+        searches_.erase(search);
+    }
+    armSearchTimer();
 }
 
+void P2PClient::expireOffers() {
+    uint64_t expirations;
+    while (read(offer_timer_fd_, &expirations, sizeof(expirations)) > 0) {}
+
+    size_t expired = offers_.expire();
+    if (expired > 0) {
+        std::cout << expired << " offer(s) expired" << std::endl;
+    }
+    armOfferTimer();
+}
+
+void P2PClient::runCommands() {
+    std::function<void()> command;
+    while (commands_.try_pop(command)) {
+        try { command(); }
+        catch (const std::exception& e) { std::cerr << "Error processing command: " << e.what() << std::endl; }
+    }
+}
+
+// Drain every datagram queued on the socket before going back to epoll
 void P2PClient::receiveMessages() {
     char buffer[4096];
     sockaddr_in server_addr{};
-    socklen_t server_len = sizeof(server_addr);
 
-    while (running_) {
-        ssize_t received = recvfrom(client_socket_, buffer, sizeof(buffer) - 1, 0,
+    while (true) {
+        socklen_t server_len = sizeof(server_addr);
+        // Binary encodings carry NUL bytes, the payload is only ever taken by length
+        ssize_t received = recvfrom(client_socket_, buffer, sizeof(buffer), 0,
                                     (struct sockaddr*)&server_addr, &server_len);
-
-        if (received > 0) {
-            buffer[received] = '\0';
-            handleReceivedMessage(std::string(buffer));
+        if (received < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                P2P_LOG_WARN("recvfrom failed: " << std::strerror(errno));
+            }
+            return;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        handleReceivedMessage(std::string(buffer, received));
     }
 }
 
@@ -409,9 +637,23 @@ void P2PClient::handleReceivedMessage(const std::string& message) {
     }
 
     switch (event->getType()) {
-    case P2PEventType::REGISTERED:
+    case P2PEventType::REGISTERED: {
+        WireEncoding granted = WireEncoding::JSON;
+        WireCodec::encodingFromName(event->getData().encoding, granted);
+        wire_encoding_ = granted;
         current_state_ = P2PStateType::REGISTERED;
-        std::cout << "Successfully registered with server" << std::endl;
+        std::cout << "Successfully registered with server ("
+            << WireCodec::encodingName(granted) << " encoding)" << std::endl;
+        publishInventory();
+        armInventoryTimer(true);
+        break;
+    }
+
+    case P2PEventType::INVENTORY_RESYNC:
+        if (current_state_ == P2PStateType::REGISTERED) {
+            P2P_LOG_INFO("Server inventory out of sync, publishing it again");
+            publishInventory();
+        }
         break;
 
     case P2PEventType::REGISTER_DENIED:
@@ -420,22 +662,18 @@ void P2PClient::handleReceivedMessage(const std::string& message) {
         break;
 
     case P2PEventType::SEARCH:
-        handleSearchEvent(event);
+        handleSearchEvent(*event);
         break;
 
     case P2PEventType::FOUND:
-        current_state_ = P2PStateType::REGISTERED;
-        std::cout << "Item found! Ready for purchase" << std::endl;
-        break;
-
     case P2PEventType::NOT_FOUND:
-        current_state_ = P2PStateType::REGISTERED;
-        std::cout << "Item not found" << std::endl;
+    case P2PEventType::NOT_AVAILABLE:
+        handleSearchResult(*event);
         break;
 
     case P2PEventType::OFFER:
     case P2PEventType::NEGOTIATE:
-        handleOfferEvent(event);
+        handleOfferEvent(*event);
         break;
 
     case P2PEventType::ACCEPT:
@@ -451,60 +689,90 @@ void P2PClient::handleReceivedMessage(const std::string& message) {
     }
 }
 
-void P2PClient::handleOfferEvent(const std::shared_ptr<P2PEvent>& event) {
+// FOUND, NOT_FOUND and NOT_AVAILABLE each close the search with their rq
+void P2PClient::handleSearchResult(const P2PEvent& event) {
+    const auto& data = event.getData();
+    auto search = searches_.find(data.request_number);
+    if (search == searches_.end()) {
+        P2P_LOG_DEBUG("Result for unknown request " << data.request_number);
+        return;
+    }
+
+    std::cout << "Search #" << data.request_number << " for " << search->second.item_name << ": ";
+    if (event.getType() == P2PEventType::FOUND) {
+        std::cout << "found at $" << std::fixed << std::setprecision(2) << data.price << ", ready for purchase";
+    }
+    else if (event.getType() == P2PEventType::NOT_FOUND) {
+        std::cout << "not found";
+    }
+    else {
+        std::cout << "no seller lists it";
+    }
+    std::cout << std::endl;
+    searches_.erase(search);
+}
+
+void P2PClient::handleOfferEvent(const P2PEvent& event) {
     if (current_state_ != P2PStateType::REGISTERED) {
         return; // Only registered peers can respond to searches
     }
 
-    std::cout << "Received offer from peer (execute \"ls offers\" to see the offers)" << std::endl;
-    auto messageData = event->getData();
+    const auto& messageData = event.getData();
+    // Offers answer our own searches; a NEGOTIATE is a buyer's counter to one of our listings
+    if (event.getType() == P2PEventType::OFFER && !searches_.count(messageData.request_number)) {
+        P2P_LOG_DEBUG("Dropping offer for unknown request " << messageData.request_number);
+        return;
+    }
 
-    offers_.push_back({
-        messageData.request_number,
-        messageData.item_name,
-        messageData.item_name,
-        messageData.price,
-    });
+    std::cout << "Received offer for request #" << messageData.request_number
+        << " (execute \"listOffers\" to see the offers)" << std::endl;
+
+    offers_.add(messageData.request_number, messageData.item_name, messageData.price);
+    if (!offer_timer_armed_) {
+        armOfferTimer();
+    }
 }
 
-void P2PClient::handleSearchEvent(const std::shared_ptr<P2PEvent>& event) {
+void P2PClient::handleSearchEvent(const P2PEvent& event) {
     if (current_state_ != P2PStateType::REGISTERED) {
         return; // Only registered peers can respond to searches
     }
 
-    const auto& data = event->getData();
-    std::string item_name = data.item_name;
+    const auto& data = event.getData();
     int request_number = data.request_number;
 
-    // Check if we have the item in our inventory
-    for (const auto& item : inventory_) {
-        if (item.name == item_name) {
-            // Found the item, send an offer
-            json offer_msg = {
-                {"command", "OFFER"},
-                {"rq", request_number},
-                {"name", name_}, // Our name as the offering peer
-                {"item_name", item_name},
-                {"price", item.price}
-            };
-
-            logOutgoingMessage(offer_msg);
-            sendMessage(offer_msg);
-
-            std::cout << "Sent offer for item: " << item_name
-                << " at price: $" << item.price << std::endl;
-            return;
-        }
+    // A fuzzy search takes the closest name we sell, the cheapest listing on a tie
+    const ClientInventory::Listing* match = data.fuzzy
+        ? inventory_.closest(data.item_name)
+        : inventory_.cheapest(data.item_name);
+
+    if (!match) {
+        return;
     }
+
+    // Found the item, send an offer
+    json offer_msg = {
+        {"command", "OFFER"},
+        {"rq", request_number},
+        {"name", name_}, // Our name as the offering peer
+        {"item_name", match->name},
+        {"price", match->price}
+    };
+
+    logOutgoingMessage(offer_msg);
+    sendMessage(offer_msg);
+
+    std::cout << "Sent offer for item: " << match->name
+        << " at price: $" << match->price << std::endl;
 }
 
 // Buyer receives accept event
-void P2PClient::handleAcceptEvent(const std::shared_ptr<P2PEvent>& event) {
+void P2PClient::handleAcceptEvent(const P2PEvent& event) {
     if (current_state_ != P2PStateType::REGISTERED) {
         return; // Only registered peers can respond to searches
     }
 
-    const auto& data = event->getData();
+    const auto& data = event.getData();
     const std::string& name = data.item_name;
 
     // Buy Item
@@ -521,26 +789,23 @@ void P2PClient::handleAcceptEvent(const std::shared_ptr<P2PEvent>& event) {
 }
 
 // Seller receives Buy event
-void P2PClient::handleBuyEvent(const std::shared_ptr<P2PEvent>& event) {
+void P2PClient::handleBuyEvent(const P2PEvent& event) {
     if (current_state_ != P2PStateType::REGISTERED) {
         return; // Only registered peers can respond to searches
     }
 
-    const auto& data = event->getData();
+    const auto& data = event.getData();
     const std::string& name = data.item_name;
 
-    // Check if item is still in inventory
-    auto it = std::find_if(inventory_.begin(), inventory_.end(), [&name](const Item& item) {
-        return item.name == name;
-    });
-
-    if (it == inventory_.end()) {
+    // Hand over one unit of the cheapest listing, the one we offered
+    ClientInventory::Change taken = inventory_.take(name);
+    if (!taken.applied) {
         std::cout << "Item was not found in inventory";
         return;
     }
-
-    // Remove from inventory
-    inventory_.erase(it);
+    if (taken.spelling_changed) {
+        syncInventory("REMOVE_ITEM", name);
+    }
 
     // Ship Item
     json buy_msg = {
@@ -556,7 +821,7 @@ void P2PClient::handleBuyEvent(const std::shared_ptr<P2PEvent>& event) {
     sendMessage(buy_msg);
 }
 
-void P2PClient::handleShippedEvent(const std::shared_ptr<P2PEvent>& event) {
+void P2PClient::handleShippedEvent(const P2PEvent& event) {
     if (current_state_ != P2PStateType::REGISTERED) {
         return; // Only registered peers can respond to searches
     }
@@ -568,30 +833,51 @@ void P2PClient::handleShippedEvent(const std::shared_ptr<P2PEvent>& event) {
 
 
 bool P2PClient::sendMessage(const json& msg) {
-    std::string message = msg.dump();
-    sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(server_port_);
-    inet_pton(AF_INET, server_ip_.c_str(), &server_addr.sin_addr);
+    std::string message = WireCodec::encode(msg, wire_encoding_);
 
-    ssize_t sent = sendto(client_socket_, message.c_str(), message.length(), 0,
-                          (struct sockaddr*)&server_addr, sizeof(server_addr));
+    ssize_t sent = socket_connected_
+        ? send(client_socket_, message.data(), message.length(), 0)
+        : sendto(client_socket_, message.data(), message.length(), 0,
+                 (struct sockaddr*)&server_addr_, sizeof(server_addr_));
 
-    return sent == message.length();
+    return sent == static_cast<ssize_t>(message.length());
 }
 
-int P2PClient::getNextRequestNumber() { return next_request_number_++; }
+bool P2PClient::resolveServerAddress(const std::string& server_ip, uint16_t server_port, sockaddr_in& addr) {
+    addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server_port);
+    return inet_pton(AF_INET, server_ip.c_str(), &addr.sin_addr) == 1;
+}
 
-std::string P2PClient::getLocalIpAddress() {
-    char hostname[256];
-    gethostname(hostname, sizeof(hostname));
+// The kernel keeps the route from here on and drops datagrams from anyone
+// but the server. Connecting again simply re-targets the socket.
+bool P2PClient::connectToServer() {
+    if (connect(client_socket_, (struct sockaddr*)&server_addr_, sizeof(server_addr_)) < 0) {
+        P2P_LOG_ERROR("Failed to connect UDP socket to " << server_ip_ << ":" << server_port_
+                      << ": " << std::strerror(errno));
+        socket_connected_ = false;
+        return false;
+    }
+    socket_connected_ = true;
+    return true;
+}
 
-    struct hostent* host_entry = gethostbyname(hostname);
-    if (!host_entry) { return "127.0.0.1"; }
+bool P2PClient::setServerAddress(const std::string& server_ip, uint16_t server_port) {
+    sockaddr_in addr{};
+    if (!resolveServerAddress(server_ip, server_port, addr)) {
+        std::cout << "Invalid server address " << server_ip << std::endl;
+        return false;
+    }
 
-    return inet_ntoa(*((struct in_addr*)host_entry->h_addr_list[0]));
+    server_ip_ = server_ip;
+    server_port_ = server_port;
+    server_addr_ = addr;
+    return socket_connected_ ? connectToServer() : true;
 }
 
+int P2PClient::getNextRequestNumber() { return next_request_number_++; }
+
 uint16_t P2PClient::getLocalPort() {
     sockaddr_in addr{};
     socklen_t addr_len = sizeof(addr);
@@ -600,36 +886,128 @@ uint16_t P2PClient::getLocalPort() {
 }
 
 
-struct Item {
-    std::string name;
-    std::string description;
-    double price;
-};
-
-void P2PClient::addItem(const std::string& name, const std::string& description, double price) {
-    inventory_.push_back({name, description, price});
-    std::cout << "Added item to inventory: " << name << " at price: $" << price << std::endl;
+void P2PClient::addItem(const std::string& name, const std::string& description, double price, int quantity) {
+    if (name.size() > kMaxItemNameLength) {
+        std::cout << "Item name is longer than " << kMaxItemNameLength << " characters" << std::endl;
+        return;
+    }
+    ClientInventory::Change added = inventory_.add(name, description, price, quantity);
+    if (!added.applied) {
+        std::cout << "Quantity must be positive" << std::endl;
+        return;
+    }
+    std::cout << "Added " << quantity << " x " << name << " to inventory at price: $" << price << std::endl;
+    if (added.spelling_changed) {
+        syncInventory("ADD_ITEM", name);
+    }
 }
 
 void P2PClient::removeItem(const std::string& name) {
-    auto it = std::find_if(inventory_.begin(), inventory_.end(),
-                           [&name](const Item& item) { return item.name == name; });
-
-    if (it != inventory_.end()) {
-        inventory_.erase(it);
+    ClientInventory::Change removed = inventory_.remove(name);
+    if (removed.applied) {
         std::cout << "Removed item from inventory: " << name << std::endl;
+        if (removed.spelling_changed) {
+            syncInventory("REMOVE_ITEM", name);
+        }
+    }
+}
+
+bool P2PClient::hasItem(const std::string& name) const {
+    return inventory_.contains(name);
+}
+
+void P2PClient::syncInventory(const char* command, const std::string& item_name) {
+    if (current_state_ == P2PStateType::UNREGISTERED) {
+        return;
+    }
+
+    json update_msg = {
+        {"command", command},
+        {"rq", getNextRequestNumber()},
+        {"name", name_},
+        {"item_name", item_name}
+    };
+
+    logOutgoingMessage(update_msg);
+    sendMessage(update_msg);
+}
+
+// Chunks share a generation, so the server swaps its old copy for this one
+// whatever order they arrive in. Each chunk stays under the server's datagram
+// limit: a name costs at most its quoted JSON length in any of the encodings.
+void P2PClient::publishInventory() {
+    int generation = getNextRequestNumber();
+    std::vector<std::string> names = inventory_.spellings();
+    size_t next = 0;
+    size_t chunks = 0;
+    do {
+        json chunk_msg = {
+            {"command", "ADD_ITEMS"},
+            {"rq", getNextRequestNumber()},
+            {"name", name_},
+            {"generation", generation},
+            {"items", json::array()}
+        };
+        // Slack covers the array header growing in msgpack and cbor
+        size_t budget = kMaxDatagramSize - kChunkSlack - WireCodec::encode(chunk_msg, wire_encoding_).size();
+        json& items = chunk_msg["items"];
+        size_t used = 0;
+        while (next < names.size()) {
+            size_t cost = json(names[next]).dump().size() + 1;
+            if (used + cost > budget) {
+                break;
+            }
+            used += cost;
+            items.push_back(std::move(names[next++]));
+        }
+
+        logOutgoingMessage(chunk_msg);
+        sendMessage(chunk_msg);
+        ++chunks;
+    } while (next < names.size());
+
+    P2P_LOG_DEBUG("Published " << names.size() << " item(s) in " << chunks << " ADD_ITEMS message(s)");
+}
+
+void P2PClient::armInventoryTimer(bool enabled) {
+    itimerspec spec{};
+    if (enabled) {
+        spec.it_value.tv_sec = kInventoryCheckInterval.count();
+        spec.it_interval.tv_sec = kInventoryCheckInterval.count();
     }
+    timerfd_settime(inventory_timer_fd_, 0, &spec, nullptr);
+}
+
+// ADD_ITEM, REMOVE_ITEM and ADD_ITEMS are fire-and-forget; the server answers
+// INVENTORY_RESYNC if any of them went missing
+void P2PClient::checkInventory() {
+    uint64_t expirations;
+    while (read(inventory_timer_fd_, &expirations, sizeof(expirations)) > 0) {}
+
+    if (current_state_ != P2PStateType::REGISTERED) {
+        return;
+    }
+
+    json check_msg = {
+        {"command", "INVENTORY_CHECK"},
+        {"rq", getNextRequestNumber()},
+        {"name", name_},
+        {"count", inventory_.spellingCount()},
+        {"digest", inventory_.digest()}
+    };
+    sendMessage(check_msg);
 }
 
 void P2PClient::listInventory() {
     std::cout << "\n=== Current Inventory ===" << std::endl;
     if (inventory_.empty()) { std::cout << "No items in inventory" << std::endl; }
     else {
-        for (const auto& item : inventory_) {
+        inventory_.forEach([](const ClientInventory::Listing& item) {
             std::cout << "Item: " << item.name << std::endl;
             std::cout << "Description: " << item.description << std::endl;
             std::cout << "Price: $" << std::fixed << std::setprecision(2) << item.price << std::endl;
+            std::cout << "Quantity: " << item.quantity << std::endl;
             std::cout << "-------------------" << std::endl;
-        }
+        });
     }
 }
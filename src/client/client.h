@@ -6,13 +6,23 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <optional>
 #include <iostream>
 #include <iomanip>
-#include <netdb.h>
+#include <functional>
+#include <unordered_map>
 
+#include "ClientInventory.h"
+#include "LocalAddress.h"
+#include "OfferBook.h"
 #include "../P2P/P2PEvent.h"
 #include "../P2P/P2PState.h"
+#include "../util/ConcurrentQueue.h"
+#include "../util/ItemMatch.h"
 #include "../util/MessageParser.h"
+#include "../util/WireCodec.h"
+#include "../util/Logger.h"
 
 class P2PClient {
 public:
@@ -22,6 +32,13 @@ public:
         uint16_t server_port;
         uint16_t udp_port;
         uint16_t tcp_port;
+        WireEncoding encoding;
+        // Connect the UDP socket to the server at registration and send with send()
+        bool connected_udp;
+        // Interface whose address is advertised, empty picks one automatically
+        std::string interface_name;
+        // How long a received offer can be acted on
+        std::chrono::seconds offer_ttl;
     };
 
     explicit P2PClient(const ClientConfig& config)
@@ -30,9 +47,18 @@ public:
           server_port_(config.server_port),
           udp_port_(config.udp_port),
           tcp_port_(config.tcp_port),
+          preferred_encoding_(config.encoding),
+          wire_encoding_(WireEncoding::JSON),
+          connected_udp_(config.connected_udp),
+          local_address_(config.interface_name),
           current_state_(P2PStateType::UNREGISTERED),
           running_(false),
-          next_request_number_(1) { setupSocket(); }
+          next_request_number_(1),
+          commands_(kCommandQueueCapacity),
+          offers_(config.offer_ttl) {
+        setupSocket();
+        setupEventLoop();
+    }
 
     ~P2PClient();
 
@@ -44,7 +70,8 @@ public:
 
     bool deregister();
 
-    bool searchItem(const std::string& item_name, const std::string& description, double max_price);
+    bool searchItem(const std::string& item_name, const std::string& description, double max_price,
+                    bool fuzzy = false, double good_price = 0.0, int expected_offers = 0);
 
     bool negotiateOffer(int request_number, const std::string& item_name, double counter_price);
 
@@ -52,10 +79,14 @@ public:
 
     bool refuseOffer(int request_number, const std::string& item_name, double price);
 
+    // Point the client at another server; a connected socket is re-connected
+    bool setServerAddress(const std::string& server_ip, uint16_t server_port);
+
     static ClientConfig parseCommandLine(int argc, char* argv[]) {
-        if (argc != 6) {
+        if (argc < 6 || argc > 10) {
             std::cerr << "Usage: " << argv[0]
-                << " <client_name> <server_ip> <server_port> <tcp_port>" << std::endl;
+                << " <client_name> <server_ip> <server_port> <udp_port> <tcp_port>"
+                << " [json|msgpack|cbor] [connected] [iface=<name>] [offer_ttl=<seconds>]" << std::endl;
             std::cerr << "Example: " << argv[0]
                 << " peer1 127.0.0.1 8080 5000 5001" << std::endl;
             throw std::runtime_error("Invalid number of arguments");
@@ -68,6 +99,21 @@ public:
             config.server_port = static_cast<uint16_t>(std::stoi(argv[3]));
             config.udp_port = static_cast<uint16_t>(std::stoi(argv[4]));
             config.tcp_port = static_cast<uint16_t>(std::stoi(argv[5]));
+            config.encoding = WireEncoding::JSON;
+            config.connected_udp = false;
+            config.offer_ttl = kDefaultOfferTtl;
+            for (int i = 6; i < argc; ++i) {
+                std::string option = argv[i];
+                if (option == "connected") { config.connected_udp = true; }
+                else if (option.rfind("iface=", 0) == 0) { config.interface_name = option.substr(6); }
+                else if (option.rfind("offer_ttl=", 0) == 0) {
+                    config.offer_ttl = std::chrono::seconds(std::stoi(option.substr(10)));
+                    if (config.offer_ttl.count() <= 0) { throw std::runtime_error("offer_ttl must be positive"); }
+                }
+                else if (!WireCodec::encodingFromName(option, config.encoding)) {
+                    throw std::runtime_error("Unknown option " + option);
+                }
+            }
 
             // Validate ports
             if (config.server_port <= 0 || config.server_port > 65535 ||
@@ -91,37 +137,114 @@ private:
     uint16_t server_port_;
     uint16_t udp_port_;
     uint16_t tcp_port_;
+    // Requested at REGISTER; messages stay JSON until the server grants it
+    WireEncoding preferred_encoding_;
+    std::atomic<WireEncoding> wire_encoding_;
+    bool connected_udp_;
+    LocalAddress local_address_;
     int client_socket_;
+    // Built once from server_ip_/server_port_ instead of on every send
+    sockaddr_in server_addr_{};
+    // Set while the socket is connected to server_addr_
+    bool socket_connected_ = false;
     P2PStateType current_state_;
     std::atomic<bool> running_;
     std::atomic<int> next_request_number_;
-    std::thread receive_thread_;
 
-    struct Item {
-        std::string name;
-        std::string description;
-        double price;
+    // One thread owns the socket and all client state below; the CLI thread
+    // only parses input and posts commands to it
+    static constexpr int kMaxEvents = 8;
+    static constexpr std::chrono::seconds kDefaultOfferTtl{120};
+    static constexpr size_t kCommandQueueCapacity = 256;
+    // The server drops larger datagrams, inventory uploads are chunked to fit
+    static constexpr size_t kMaxDatagramSize = 4096;
+    static constexpr size_t kChunkSlack = 16;
+    // Longest item name we list; even fully escaped it fits in an ADD_ITEMS chunk
+    static constexpr size_t kMaxItemNameLength = 256;
+    // The server answers within its one-minute search timeout. A search still
+    // open after that and a margin was lost, or ended in a NEGOTIATE sent to
+    // the seller, and is dropped.
+    static constexpr std::chrono::seconds kSearchLifetime{75};
+    // How often the server is asked whether its copy of our inventory matches
+    static constexpr std::chrono::seconds kInventoryCheckInterval{30};
+    std::thread loop_thread_;
+    int epoll_fd_ = -1;
+    int command_fd_ = -1;
+    int stop_fd_ = -1;
+    ConcurrentQueue<std::function<void()>> commands_;
+
+    ClientInventory inventory_;
+
+    // Searches this client has sent and not yet seen answered, by request number
+    struct Search {
+        std::string item_name;
+        P2PStateType state;
+        std::chrono::steady_clock::time_point expires;
     };
 
-    struct Offer {
-        int requestNumber;
-        std::string name;
-        std::string description;
-        double price;
+    struct SearchDeadline {
+        std::chrono::steady_clock::time_point expires;
+        int request_number;
     };
 
-    std::vector<Item> inventory_;
+    std::unordered_map<int, Search> searches_;
+    // Every search gets the same lifetime, so deadlines come in send order,
+    // like OfferBook's. Answered searches leave entries that expiry skips.
+    std::deque<SearchDeadline> search_deadlines_;
+    int search_timer_fd_ = -1;
 
-    std::vector<Offer> offers_;
+    OfferBook offers_;
+    // One timerfd for every offer's expiry, armed for the earliest deadline
+    int offer_timer_fd_ = -1;
+    bool offer_timer_armed_ = false;
+    // Periodic while registered, fires checkInventory()
+    int inventory_timer_fd_ = -1;
 
-    void addItem(const std::string& name, const std::string& description, double price);
+    void addItem(const std::string& name, const std::string& description, double price, int quantity = 1);
 
     void removeItem(const std::string& name);
 
+    bool hasItem(const std::string& name) const;
+
+    void syncInventory(const char* command, const std::string& item_name);
+
+    // Full upload in ADD_ITEMS chunks, after REGISTERED and on INVENTORY_RESYNC
+    void publishInventory();
+
+    void armInventoryTimer(bool enabled);
+
+    void checkInventory();
+
     void listInventory();
 
+    void listOffers();
+
     void setupSocket();
 
+    void setupEventLoop();
+
+    void runEventLoop();
+
+    void runCommands();
+
+    void post(std::function<void()> command);
+
+    static void signalEventFd(int fd);
+
+    // Arms a one-shot timerfd for deadline, or disarms it without one
+    static void setTimer(int timer_fd, std::optional<std::chrono::steady_clock::time_point> deadline);
+
+    void armOfferTimer();
+
+    void armSearchTimer();
+
+    void expireSearches();
+
+    void expireOffers();
+
+    // Removes the offer an accept, refuse or negotiate acts on; prints why if it cannot
+    bool takeOffer(int request_number, const std::string& item_name, std::optional<double> price);
+
     void startCommandLoop();
 
     void processUserCommand(const std::string& command);
@@ -134,7 +257,9 @@ private:
 
     bool sendMessage(const json& msg);
 
-    std::string getLocalIpAddress();
+    bool resolveServerAddress(const std::string& server_ip, uint16_t server_port, sockaddr_in& addr);
+
+    bool connectToServer();
 
     uint16_t getLocalPort();
 
@@ -155,15 +280,19 @@ private:
 
     void handleRefuseCommand(std::istringstream& iss);
 
+    void handleServerCommand(std::istringstream& iss);
+
     void handleReceivedMessage(const std::string& message);
 
-    void handleSearchEvent(const std::shared_ptr<P2PEvent>& event);
+    void handleSearchEvent(const P2PEvent& event);
+
+    void handleSearchResult(const P2PEvent& event);
 
-    void handleOfferEvent(const std::shared_ptr<P2PEvent>& event);
+    void handleOfferEvent(const P2PEvent& event);
 
-    void handleAcceptEvent(const std::shared_ptr<P2PEvent>& event);
+    void handleAcceptEvent(const P2PEvent& event);
 
-    void handleBuyEvent(const std::shared_ptr<P2PEvent>& event);
+    void handleBuyEvent(const P2PEvent& event);
 
-    void handleShippedEvent(const std::shared_ptr<P2PEvent>& event);
+    void handleShippedEvent(const P2PEvent& event);
 };
@@ -14,8 +14,12 @@ int main(int argc, char *argv[]) {
         std::cout << "Server Port: " << config.server_port << std::endl;
         std::cout << "UDP Port: " << config.udp_port << std::endl;
         std::cout << "TCP Port: " << config.tcp_port << std::endl;
+        std::cout << "Encoding: " << WireCodec::encodingName(config.encoding) << std::endl;
         std::cout << "==============================\n" << std::endl;
 
+        // The client is interactive, show every message it sends and receives
+        Logger::setMessageDumps(true);
+
         // Create and start client
         P2PClient client(config);
         client.start();
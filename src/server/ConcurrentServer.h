@@ -1,9 +1,13 @@
 #pragma once
 
 #include <thread>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
 #include <mutex>
 #include <atomic>
 #include <memory>
+#include <vector>
 #include <unordered_map>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -12,44 +16,100 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include "EpollDatagramReceiver.h"
+#include "IoUringDatagramReceiver.h"
+#include "IoUringDatagramSender.h"
 #include "ServerCommandHandlers.h"
 #include "ServerStateMachine.h"
 #include "../util/MessageParser.h"
 #include "../util/ConcurrentQueue.h"
 #include "../util/ThreadPool.h"
+#include "../util/StrandExecutor.h"
+#include "../util/TimerWheel.h"
+#include "../util/Logger.h"
 
 
 class ConcurrentServer {
 public:
+    struct ServerConfig {
+        uint16_t port;
+        size_t thread_count;
+        size_t receiver_count;
+        IoBackend backend;
+        LogLevel log_level = LogLevel::INFO;
+        bool dump_messages = false;
+        ThreadPool::Mode pool_mode = ThreadPool::Mode::SHARED_QUEUE;
+        size_t partition_count = 1;
+    };
+
+    struct PartitionStats {
+        size_t queue_depth;
+        uint64_t processed;
+        // Time from a message task queuing an event to its transition running
+        std::chrono::microseconds last_lag;
+        std::chrono::microseconds max_lag;
+    };
+
     ConcurrentServer(uint16_t port, size_t thread_count = std::thread::hardware_concurrency())
-        : thread_pool_(thread_count),
-          event_processor_thread_([this] { processEvents(); }),
-          running_(true) {
-        setupSocket(port);
-        command_handlers_ = std::make_unique<ServerCommandHandlers>(
-            server_socket_, peer_sessions_, sessions_mutex_);
+        : ConcurrentServer(ServerConfig{port, thread_count, 1, IoBackend::EPOLL}) {
     }
 
-    void start() {
-        while (running_) {
-            sockaddr_in client_addr{};
-            socklen_t client_len = sizeof(client_addr);
-            char buffer[1024];
+    explicit ConcurrentServer(const ServerConfig& config)
+        : thread_pool_(config.thread_count, config.pool_mode),
+          strands_(thread_pool_),
+          running_(true),
+          timer_wheel_(kTimerResolution, [this](std::vector<TimerWheel::Callback>&& callbacks) {
+              thread_pool_.enqueueBatch(std::move(callbacks));
+          }) {
+        setupBackend(config);
+        command_handlers_ = std::make_unique<ServerCommandHandlers>(
+            server_socket_, *sender_, timer_wheel_, peer_registry_);
 
-            ssize_t received = recvfrom(server_socket_, buffer, sizeof(buffer) - 1, 0,
-                                        (struct sockaddr*)&client_addr, &client_len);
+        // Started last, the processors use everything above
+        for (size_t i = 0; i < config.partition_count; ++i) {
+            partitions_.push_back(std::make_unique<EventPartition>());
+        }
+        for (auto& partition : partitions_) {
+            partition->thread = std::thread([this, p = partition.get()] { processEvents(*p); });
+        }
+    }
 
-            if (received > 0) {
-                buffer[received] = '\0';
-                handleNewMessage(std::string(buffer), client_addr);
-            }
+    // Run the first receiver on the calling thread and the rest on their own threads
+    void start() {
+        for (size_t i = 1; i < receivers_.size(); ++i) {
+            receiver_threads_.emplace_back([this, i] { receivers_[i]->run(running_); });
         }
+        serving_ = true;
+        receivers_[0]->run(running_);
+        serving_ = false;
+        serving_.notify_all();
     }
 
     void stop() {
         running_ = false;
-        event_processor_thread_.join();
-        close(server_socket_);
+        timer_wheel_.stop();
+        for (auto& receiver : receivers_) {
+            receiver->wake();
+        }
+        for (auto& thread : receiver_threads_) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        // The first receiver runs on the thread that called start()
+        serving_.wait(true);
+        // Nothing feeds the pool any more. Queued message tasks and fired search
+        // timeouts still point at the handlers and partitions, let them finish.
+        thread_pool_.shutdown();
+        // Closing lets each processor drain what is queued and return
+        for (auto& partition : partitions_) {
+            partition->queue.close();
+        }
+        for (auto& partition : partitions_) {
+            if (partition->thread.joinable()) {
+                partition->thread.join();
+            }
+        }
     }
 
     ~ConcurrentServer() {
@@ -58,77 +118,256 @@ public:
         }
     }
 
+    IoBackend getBackend() const { return backend_; }
+
+    // Pending search deadlines and lifetime timer counters
+    TimerWheel::Stats getTimerStats() { return timer_wheel_.getStats(); }
+
+    // Live strands and per-peer task counters
+    StrandExecutor::Stats getStrandStats() { return strands_.getStats(); }
+
+    // Per-worker executed/stolen/idle counters
+    std::vector<ThreadPool::WorkerStats> getWorkerStats() const { return thread_pool_.getWorkerStats(); }
+
+    // SEARCH fan-out counters: recipients, sends, partial batches and drops
+    ServerCommandHandlers::BroadcastStats getBroadcastStats() const { return command_handlers_->getBroadcastStats(); }
+
+    // Listings, distinct item names and peers that published no inventory
+    ServerCommandHandlers::InventoryStats getInventoryStats() const { return command_handlers_->getInventoryStats(); }
+
+    // Per-partition event queue depth, throughput and lag
+    std::vector<PartitionStats> getPartitionStats() const {
+        std::vector<PartitionStats> stats;
+        stats.reserve(partitions_.size());
+        for (const auto& partition : partitions_) {
+            stats.push_back({
+                partition->queue.size(),
+                partition->processed.load(std::memory_order_relaxed),
+                std::chrono::microseconds(partition->last_lag_us.load(std::memory_order_relaxed)),
+                std::chrono::microseconds(partition->max_lag_us.load(std::memory_order_relaxed))
+            });
+        }
+        return stats;
+    }
+
+    // Per-receiver counters, used to check that SO_REUSEPORT spreads the load
+    std::vector<DatagramReceiver::Stats> getReceiverStats() const {
+        std::vector<DatagramReceiver::Stats> stats;
+        stats.reserve(receivers_.size());
+        for (const auto& receiver : receivers_) {
+            stats.push_back(receiver->getStats());
+        }
+        return stats;
+    }
+
+    static ServerConfig parseCommandLine(int argc, char* argv[], uint16_t default_port) {
+        ServerConfig config{default_port, 4, 1, IoBackend::EPOLL};
+        try {
+            for (int i = 1; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "--dump-messages") {
+                    config.dump_messages = true;
+                    continue;
+                }
+                if (arg == "--work-stealing") {
+                    config.pool_mode = ThreadPool::Mode::WORK_STEALING;
+                    continue;
+                }
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+                if (arg == "--port") {
+                    config.port = static_cast<uint16_t>(std::stoi(argv[++i]));
+                }
+                else if (arg == "--threads") {
+                    config.thread_count = static_cast<size_t>(std::stoul(argv[++i]));
+                }
+                else if (arg == "--receivers") {
+                    config.receiver_count = static_cast<size_t>(std::stoul(argv[++i]));
+                }
+                else if (arg == "--backend") {
+                    std::string backend = argv[++i];
+                    if (backend == "epoll") {
+                        config.backend = IoBackend::EPOLL;
+                    }
+                    else if (backend == "io_uring") {
+                        config.backend = IoBackend::IO_URING;
+                    }
+                    else {
+                        throw std::runtime_error("Unknown backend " + backend);
+                    }
+                }
+                else if (arg == "--partitions") {
+                    config.partition_count = static_cast<size_t>(std::stoul(argv[++i]));
+                }
+                else if (arg == "--log-level") {
+                    std::string level = argv[++i];
+                    if (!Logger::levelFromName(level, config.log_level)) {
+                        throw std::runtime_error("Unknown log level " + level);
+                    }
+                }
+                else {
+                    throw std::runtime_error("Unknown option " + arg);
+                }
+            }
+
+            if (config.thread_count == 0 || config.receiver_count == 0 || config.partition_count == 0) {
+                throw std::runtime_error("Thread, receiver and partition counts must be at least 1");
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Usage: " << argv[0]
+                << " [--port <port>] [--threads <count>] [--receivers <count>]"
+                << " [--backend epoll|io_uring] [--partitions <count>]"
+                << " [--log-level trace|debug|info|warn|error|off] [--dump-messages]"
+                << " [--work-stealing]" << std::endl;
+            throw std::runtime_error(std::string("Error parsing arguments: ") + e.what());
+        }
+        return config;
+    }
+
 private:
     ThreadPool thread_pool_;
-    std::thread event_processor_thread_;
+    // Messages from one peer are handled in arrival order, peers run in parallel
+    StrandExecutor strands_;
     std::atomic<bool> running_;
+    // Set while start() is inside the first receiver's loop
+    std::atomic<bool> serving_{false};
     int server_socket_;
+
+    // Search deadlines, fired callbacks run on thread_pool_
+    static constexpr std::chrono::milliseconds kTimerResolution{10};
+    TimerWheel timer_wheel_;
     std::unique_ptr<ServerCommandHandlers> command_handlers_;
 
-    ConcurrentQueue<std::pair<std::shared_ptr<P2PEvent>, sockaddr_in>> event_queue_;
-    std::unordered_map<std::string, std::shared_ptr<PeerSession>> peer_sessions_;
-    std::mutex sessions_mutex_;
-    ServerStateMachine server_state_machine_;
+    // One socket per receiver, all bound to the same port when there are several
+    std::vector<std::unique_ptr<DatagramReceiver>> receivers_;
+    std::vector<std::thread> receiver_threads_;
+    std::unique_ptr<DatagramSender> sender_;
+    IoBackend backend_;
+
+    struct QueuedEvent {
+        // Goes back to the event pool when the partition thread clears its batch
+        P2PEventPool::Handle event;
+        sockaddr_in addr;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+
+    // Events are partitioned by peer key, so one peer's transitions stay on one
+    // processor thread in arrival order and partitions share no state. Each
+    // partition tracks the server-wide state for the peers it owns.
+    struct EventPartition {
+        // Bounded, a full queue pushes back on the workers. Closed by stop().
+        ConcurrentQueue<QueuedEvent> queue;
+        ServerStateMachine server_state_machine;
+        std::thread thread;
+        std::atomic<uint64_t> processed{0};
+        std::atomic<int64_t> last_lag_us{0};
+        std::atomic<int64_t> max_lag_us{0};
+    };
 
-    void setupSocket(uint16_t port) {
-        server_socket_ = socket(AF_INET, SOCK_DGRAM, 0);
-        if (server_socket_ < 0) {
-            throw std::runtime_error("Failed to create socket");
+    static constexpr size_t kEventBatchSize = 64;
+    std::vector<std::unique_ptr<EventPartition>> partitions_;
+    PeerRegistry peer_registry_;
+
+    void setupBackend(const ServerConfig& config) {
+        backend_ = config.backend;
+        if (backend_ == IoBackend::IO_URING) {
+            try {
+                setupReceivers(config);
+            }
+            catch (const std::exception& e) {
+                // Kernels without io_uring (or sandboxes that block it) keep the epoll path
+                P2P_LOG_WARN("io_uring unavailable (" << e.what() << "), falling back to epoll");
+                receivers_.clear();
+                sender_.reset();
+                backend_ = IoBackend::EPOLL;
+            }
+        }
+        if (backend_ == IoBackend::EPOLL) {
+            setupReceivers(config);
         }
+    }
 
-        sockaddr_in server_addr{};
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_addr.s_addr = INADDR_ANY;
-        server_addr.sin_port = htons(port);
+    void setupReceivers(const ServerConfig& config) {
+        bool reuse_port = config.receiver_count > 1;
+        auto handler = [this](std::vector<Datagram>&& batch) { handleBatch(std::move(batch)); };
+        for (size_t i = 0; i < config.receiver_count; ++i) {
+            if (backend_ == IoBackend::IO_URING) {
+                receivers_.push_back(std::make_unique<IoUringDatagramReceiver>(config.port, reuse_port, handler));
+            }
+            else {
+                receivers_.push_back(std::make_unique<EpollDatagramReceiver>(config.port, reuse_port, handler));
+            }
+        }
 
-        if (bind(server_socket_, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-            close(server_socket_);
-            throw std::runtime_error("Bind failed");
+        // Replies all leave from the first socket, the source port is the same
+        server_socket_ = receivers_[0]->getSocketFd();
+        if (backend_ == IoBackend::IO_URING) {
+            sender_ = std::make_unique<IoUringDatagramSender>(server_socket_);
+        }
+        else {
+            sender_ = std::make_unique<SocketDatagramSender>(server_socket_);
         }
+    }
 
-        // Set socket to non-blocking mode
-        int flags = fcntl(server_socket_, F_GETFL, 0);
-        fcntl(server_socket_, F_SETFL, flags | O_NONBLOCK);
+    void handleBatch(std::vector<Datagram>&& batch) {
+        // Reused per receiver thread; postBatch empties it but keeps the capacity
+        thread_local std::vector<std::pair<StrandExecutor::Key, ThreadPool::Task>> tasks;
+        for (auto& datagram : batch) {
+            tasks.emplace_back(peerKey(datagram.addr), makeMessageTask(std::move(datagram.payload), datagram.addr));
+        }
+        strands_.postBatch(tasks);
     }
 
-    void handleNewMessage(const std::string& message, const sockaddr_in& client_addr) {
-        thread_pool_.enqueue([this, message, client_addr] {
+    // The payload is moved into the task, which lives inline in the pool's queue slot
+    ThreadPool::Task makeMessageTask(std::string message, const sockaddr_in& client_addr) {
+        return [this, message = std::move(message), client_addr] {
             try {
-                auto j = json::parse(message);
-                std::cout << "\n=== Received Message ===" << std::endl;
-                MessageParser::printMessage(j);
-
-                command_handlers_->handleCommand(j, client_addr);
-
+                // Parse once; the typed event feeds both the handlers and the state machines
                 auto event = parseMessage(message);
-                if (event) {
-                    event_queue_.push({event, client_addr});
+                if (!event) {
+                    return;
                 }
-            }
-            catch (const json::parse_error& e) {
-                std::cerr << "Failed to parse message: " << e.what() << std::endl;
+
+                command_handlers_->handleCommand(*event, client_addr);
+                EventPartition& partition = *partitions_[peerKey(client_addr) % partitions_.size()];
+                partition.queue.push({std::move(event), client_addr, std::chrono::steady_clock::now()});
             }
             catch (const std::exception& e) {
-                std::cerr << "Error processing message: " << e.what() << std::endl;
+                P2P_LOG_ERROR("Error processing message: " << e.what());
             }
-        });
+        };
     }
 
-    void processEvents() {
-        while (running_) {
-            std::pair<std::shared_ptr<P2PEvent>, sockaddr_in> event_pair;
-            event_queue_.wait_and_pop(event_pair);
+    void handleNewMessage(std::string message, const sockaddr_in& client_addr) {
+        strands_.post(peerKey(client_addr), makeMessageTask(std::move(message), client_addr));
+    }
 
-            auto [event, client_addr] = event_pair;
-            std::string peer_id = getPeerIdentifier(client_addr);
+    void processEvents(EventPartition& partition) {
+        std::vector<QueuedEvent> batch;
+        batch.reserve(kEventBatchSize);
+        while (partition.queue.pop_bulk(batch, kEventBatchSize) > 0) {
+            auto now = std::chrono::steady_clock::now();
+            int64_t max_lag_us = 0;
+            for (auto& queued : batch) {
+                auto lag = std::chrono::duration_cast<std::chrono::microseconds>(now - queued.queued_at);
+                max_lag_us = std::max<int64_t>(max_lag_us, lag.count());
 
-            std::lock_guard<std::mutex> lock(sessions_mutex_);
-            auto session = peer_sessions_[peer_id];
-            if (session) {
-                // Process event in both server and peer state machines
-                server_state_machine_.processEvent(event);
-                session->processEvent(event);
+                // No lock: the registry lookup is per shard and the machines belong to this partition
+                auto session = peer_registry_.find(getPeerIdentifier(queued.addr));
+                if (session) {
+                    partition.server_state_machine.processEvent(queued.event->getType());
+                    session->processEvent(*queued.event);
+                }
             }
+
+            partition.processed.fetch_add(batch.size(), std::memory_order_relaxed);
+            partition.last_lag_us.store(max_lag_us, std::memory_order_relaxed);
+            if (max_lag_us > partition.max_lag_us.load(std::memory_order_relaxed)) {
+                partition.max_lag_us.store(max_lag_us, std::memory_order_relaxed);
+            }
+            batch.clear();
         }
     }
 
@@ -136,13 +375,18 @@ private:
         const std::string& peer_id,
         const sockaddr_in& client_addr
     ) {
-        auto it = peer_sessions_.find(peer_id);
-        if (it == peer_sessions_.end()) {
-            auto session = std::make_shared<PeerSession>(server_socket_, client_addr);
-            peer_sessions_[peer_id] = session;
+        if (auto session = peer_registry_.find(peer_id)) {
             return session;
         }
-        return it->second;
+        auto session = std::make_shared<PeerSession>(server_socket_, client_addr);
+        if (!peer_registry_.insert(peer_id, session)) {
+            return peer_registry_.find(peer_id);
+        }
+        return session;
+    }
+
+    static StrandExecutor::Key peerKey(const sockaddr_in& addr) {
+        return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
     }
 
     std::string getPeerIdentifier(const sockaddr_in& addr) {
@@ -150,13 +394,13 @@ private:
             std::to_string(ntohs(addr.sin_port));
     }
 
-    std::shared_ptr<P2PEvent> parseMessage(const std::string& message) {
+    P2PEventPool::Handle parseMessage(const std::string& message) {
         return MessageParser::parseMessage(message);
     }
 
     void handleStateTransition(
         const std::shared_ptr<PeerSession>& session,
-        const std::shared_ptr<P2PEvent>& event
+        const P2PEvent& event
     ) {
     }
 };
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <functional>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// A received datagram and the address it came from
+struct Datagram {
+    std::string payload;
+    sockaddr_in addr;
+};
+
+// I/O backends the server can be started with
+enum class IoBackend {
+    EPOLL,
+    IO_URING
+};
+
+// Owns one UDP socket and hands received datagrams to the server in batches.
+// Several receivers can share a port through SO_REUSEPORT, the kernel then
+// spreads datagrams across their sockets.
+class DatagramReceiver {
+public:
+    using BatchHandler = std::function<void(std::vector<Datagram>&&)>;
+
+    struct Stats {
+        uint64_t datagrams;
+        uint64_t batches;
+        uint64_t bytes;
+        uint64_t dropped;
+    };
+
+    explicit DatagramReceiver(BatchHandler handler) : handler_(std::move(handler)), socket_(-1) {
+    }
+
+    virtual ~DatagramReceiver() {
+        if (socket_ >= 0) {
+            close(socket_);
+        }
+    }
+
+    DatagramReceiver(const DatagramReceiver&) = delete;
+    DatagramReceiver& operator=(const DatagramReceiver&) = delete;
+
+    // Receive until running is cleared and wake() is called
+    virtual void run(const std::atomic<bool>& running) = 0;
+
+    // Break run() out of its wait so it can observe the running flag
+    virtual void wake() = 0;
+
+    int getSocketFd() const { return socket_; }
+
+    Stats getStats() const {
+        return {datagrams_.load(), batches_.load(), bytes_.load(), dropped_.load()};
+    }
+
+protected:
+    static constexpr size_t kMaxDatagramSize = 4096;
+
+    BatchHandler handler_;
+    int socket_;
+
+    std::atomic<uint64_t> datagrams_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    void openSocket(uint16_t port, bool reuse_port, bool non_blocking) {
+        socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+        if (socket_ < 0) {
+            throw std::runtime_error("Failed to create socket");
+        }
+
+        if (reuse_port) {
+            int enable = 1;
+            if (setsockopt(socket_, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+                close(socket_);
+                socket_ = -1;
+                throw std::runtime_error("Failed to set SO_REUSEPORT");
+            }
+        }
+
+        sockaddr_in server_addr{};
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_addr.s_addr = INADDR_ANY;
+        server_addr.sin_port = htons(port);
+
+        if (bind(socket_, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+            close(socket_);
+            socket_ = -1;
+            throw std::runtime_error("Bind failed");
+        }
+
+        if (non_blocking) {
+            int flags = fcntl(socket_, F_GETFL, 0);
+            fcntl(socket_, F_SETFL, flags | O_NONBLOCK);
+        }
+    }
+
+    void deliver(std::vector<Datagram>&& batch) {
+        if (batch.empty()) {
+            return;
+        }
+        datagrams_ += batch.size();
+        batches_++;
+        handler_(std::move(batch));
+    }
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// Outcome of sending one payload to a list of recipients
+struct SendResult {
+    size_t sent;
+    uint64_t partial_sends;
+    uint64_t eagain_count;
+};
+
+// Outbound half of the server I/O backend, shared by all handler threads
+class DatagramSender {
+public:
+    virtual ~DatagramSender() = default;
+
+    virtual bool send(const std::string& payload, const sockaddr_in& addr) = 0;
+    virtual SendResult sendBatch(const std::string& payload, const std::vector<sockaddr_in>& recipients) = 0;
+};
+
+// Plain socket path: sendto for single datagrams, chunked sendmmsg for fan-outs
+class SocketDatagramSender : public DatagramSender {
+public:
+    explicit SocketDatagramSender(int socket_fd) : socket_fd_(socket_fd) {
+    }
+
+    bool send(const std::string& payload, const sockaddr_in& addr) override {
+        ssize_t sent = sendto(socket_fd_, payload.c_str(), payload.length(), 0,
+                              (struct sockaddr*)&addr, sizeof(addr));
+        return sent == static_cast<ssize_t>(payload.length());
+    }
+
+    SendResult sendBatch(const std::string& payload, const std::vector<sockaddr_in>& recipients) override {
+        SendResult result{0, 0, 0};
+        if (recipients.empty()) {
+            return result;
+        }
+
+        // Every datagram shares the same payload, only the destination differs
+        iovec iov{const_cast<char*>(payload.data()), payload.length()};
+
+        std::vector<mmsghdr> msgs(recipients.size());
+        for (size_t i = 0; i < recipients.size(); ++i) {
+            msgs[i].msg_hdr = {};
+            msgs[i].msg_hdr.msg_name = const_cast<sockaddr_in*>(&recipients[i]);
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iov;
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        size_t offset = 0;
+        while (offset < msgs.size()) {
+            unsigned int chunk = static_cast<unsigned int>(std::min(kChunkSize, msgs.size() - offset));
+            int sent = sendmmsg(socket_fd_, msgs.data() + offset, chunk, 0);
+
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    // Socket buffer is full, the rest of the broadcast is dropped
+                    ++result.eagain_count;
+                    break;
+                }
+                // The datagram at offset failed on its own, skip it and keep going
+                ++offset;
+                continue;
+            }
+
+            if (static_cast<unsigned int>(sent) < chunk) {
+                ++result.partial_sends;
+            }
+            offset += sent;
+            result.sent += sent;
+        }
+        return result;
+    }
+
+protected:
+    int socket_fd_;
+
+private:
+    // Largest number of datagrams handed to a single sendmmsg call
+    static constexpr size_t kChunkSize = 256;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "DatagramReceiver.h"
+#include "../util/Logger.h"
+
+// Blocks in epoll until the socket is readable, then drains it with recvmmsg
+class EpollDatagramReceiver : public DatagramReceiver {
+public:
+    EpollDatagramReceiver(uint16_t port, bool reuse_port, BatchHandler handler)
+        : DatagramReceiver(std::move(handler)) {
+        openSocket(port, reuse_port, true);
+        setupEpoll();
+        setupReceiveBatch();
+    }
+
+    ~EpollDatagramReceiver() override {
+        close(wakeup_fd_);
+        close(epoll_fd_);
+    }
+
+    void run(const std::atomic<bool>& running) override {
+        epoll_event events[2];
+        while (running) {
+            int ready = epoll_wait(epoll_fd_, events, 2, -1);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("epoll_wait failed: ") + std::strerror(errno));
+            }
+
+            for (int i = 0; i < ready; ++i) {
+                if (events[i].data.fd == socket_) {
+                    drainSocket();
+                }
+            }
+        }
+    }
+
+    void wake() override {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeup_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+private:
+    // Preallocated recvmmsg state, only touched by the receive loop
+    static constexpr size_t kRecvBatchSize = 64;
+
+    int epoll_fd_;
+    int wakeup_fd_;
+
+    std::vector<std::array<char, kMaxDatagramSize>> recv_buffers_;
+    std::vector<sockaddr_in> recv_addrs_;
+    std::vector<iovec> recv_iovecs_;
+    std::vector<mmsghdr> recv_msgs_;
+
+    void setupEpoll() {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            throw std::runtime_error("Failed to create epoll instance");
+        }
+
+        wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeup_fd_ < 0) {
+            close(epoll_fd_);
+            throw std::runtime_error("Failed to create wakeup eventfd");
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = socket_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket_, &ev);
+
+        ev.data.fd = wakeup_fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev);
+    }
+
+    void setupReceiveBatch() {
+        recv_buffers_.resize(kRecvBatchSize);
+        recv_addrs_.resize(kRecvBatchSize);
+        recv_iovecs_.resize(kRecvBatchSize);
+        recv_msgs_.resize(kRecvBatchSize);
+
+        for (size_t i = 0; i < kRecvBatchSize; ++i) {
+            recv_iovecs_[i].iov_base = recv_buffers_[i].data();
+            recv_iovecs_[i].iov_len = kMaxDatagramSize;
+            recv_msgs_[i].msg_hdr = {};
+            recv_msgs_[i].msg_hdr.msg_name = &recv_addrs_[i];
+            recv_msgs_[i].msg_hdr.msg_iov = &recv_iovecs_[i];
+            recv_msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    // Read datagrams until the socket would block, one recvmmsg per batch
+    void drainSocket() {
+        while (true) {
+            for (auto& msg : recv_msgs_) {
+                msg.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                msg.msg_hdr.msg_flags = 0;
+            }
+
+            int received = recvmmsg(socket_, recv_msgs_.data(), kRecvBatchSize,
+                                    MSG_DONTWAIT, nullptr);
+            if (received <= 0) {
+                if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    P2P_LOG_ERROR("recvmmsg failed: " << std::strerror(errno));
+                }
+                return;
+            }
+
+            std::vector<Datagram> batch;
+            batch.reserve(received);
+            for (int i = 0; i < received; ++i) {
+                if (recv_msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    dropped_++;
+                    P2P_LOG_WARN("Dropped oversized datagram");
+                    continue;
+                }
+                bytes_ += recv_msgs_[i].msg_len;
+                batch.push_back({std::string(recv_buffers_[i].data(), recv_msgs_[i].msg_len), recv_addrs_[i]});
+            }
+            deliver(std::move(batch));
+
+            if (static_cast<size_t>(received) < kRecvBatchSize) {
+                return;
+            }
+        }
+    }
+};
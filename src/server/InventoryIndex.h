@@ -0,0 +1,265 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "PeerRegistry.h"
+#include "PeerSession.h"
+#include "../util/ItemMatch.h"
+#include "../util/ItemNameIndex.h"
+
+// Inverted index from item name to the peers that sell it, fed by the
+// inventories peers publish at REGISTER or in ADD_ITEMS chunks and by their
+// ADD_ITEM / REMOVE_ITEM updates. A SEARCH then only goes to the sellers of
+// the item instead of every registered peer.
+//
+// Updates are fire-and-forget datagrams, so each peer's listing also keeps a
+// digest the peer can check its own inventory against and resync on mismatch.
+//
+// Peers that never publish an inventory (older clients) are kept apart and
+// still receive every search, so they are not silently cut off.
+//
+// All updates for one peer arrive on that peer's strand, so they never race
+// each other; the locks only keep different peers and lookups apart.
+class InventoryIndex {
+public:
+    // Replaces whatever the peer had published before
+    void publish(const std::string& peer_id, const std::shared_ptr<PeerSession>& session,
+                 const std::vector<std::string>& items) {
+        removePeer(peer_id);
+        for (const auto& item : items) {
+            addItem(peer_id, session, item);
+        }
+        PeerShard& shard = peerShardFor(peer_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.items.try_emplace(peer_id);
+    }
+
+    // One chunk of a full inventory upload. The first chunk of a newer
+    // generation replaces what the peer listed, later chunks of it add to
+    // that, and chunks of an older generation arrived too late to matter.
+    void publishChunk(const std::string& peer_id, const std::shared_ptr<PeerSession>& session,
+                      int generation, const std::vector<std::string>& items) {
+        bool replace;
+        {
+            PeerShard& shard = peerShardFor(peer_id);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            PeerItems& peer = shard.items[peer_id];
+            if (generation < peer.generation) {
+                return;
+            }
+            replace = generation > peer.generation;
+            peer.generation = generation;
+        }
+        if (replace) {
+            unlistAll(peer_id, false);
+        }
+        // Publishing, even nothing, takes the peer off the every-search list
+        unindexed_peers_.erase(peer_id);
+        for (const auto& item : items) {
+            addItem(peer_id, session, item);
+        }
+    }
+
+    // Whether the peer's listing matches the count and digest it reports
+    bool inSync(const std::string& peer_id, size_t count, uint64_t digest) {
+        PeerShard& shard = peerShardFor(peer_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.items.find(peer_id);
+        if (it == shard.items.end()) {
+            return count == 0 && digest == 0;
+        }
+        return it->second.names.size() == count && it->second.digest == digest;
+    }
+
+    void addItem(const std::string& peer_id, const std::shared_ptr<PeerSession>& session,
+                 const std::string& item) {
+        {
+            PeerShard& shard = peerShardFor(peer_id);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            PeerItems& peer = shard.items[peer_id];
+            if (!peer.names.insert(item).second) {
+                return;
+            }
+            peer.digest += ItemMatch::fingerprint(item);
+        }
+        // A peer that starts publishing no longer needs every search
+        unindexed_peers_.erase(peer_id);
+
+        ItemShard& shard = itemShardFor(item);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto [sellers, first_seller] = shard.sellers.try_emplace(item);
+        sellers->second.emplace(peer_id, session);
+        if (first_seller) {
+            std::unique_lock<std::shared_mutex> names_lock(names_mutex_);
+            names_.insert(item);
+        }
+        listings_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void removeItem(const std::string& peer_id, const std::string& item) {
+        {
+            PeerShard& shard = peerShardFor(peer_id);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.items.find(peer_id);
+            if (it == shard.items.end() || it->second.names.erase(item) == 0) {
+                return;
+            }
+            it->second.digest -= ItemMatch::fingerprint(item);
+        }
+        unlist(peer_id, item);
+    }
+
+    // Peer that registered without an inventory, it gets every search
+    void addUnindexed(const std::string& peer_id, std::shared_ptr<PeerSession> session) {
+        unindexed_peers_.insert(peer_id, std::move(session));
+    }
+
+    // Forget everything about the peer, on deregistration
+    void removePeer(const std::string& peer_id) {
+        unindexed_peers_.erase(peer_id);
+        unlistAll(peer_id, true);
+    }
+
+    // Visit every peer that may have the item: its sellers, then the unindexed peers.
+    // A fuzzy search covers the sellers of every name ItemNameIndex matches,
+    // each peer visited once. listed tells the sellers of the exact name,
+    // which are sure to answer, from peers that may stay silent. Sellers are
+    // visited under their item's shard lock, keep the visitor short.
+    void forEachCandidate(const std::string& item, bool fuzzy,
+                          const std::function<void(const PeerRegistry::Entry&, bool listed)>& visit) {
+        if (!fuzzy) {
+            visitSellers(item, [&](const PeerRegistry::Entry& entry) { visit(entry, true); });
+        }
+        else {
+            // The exact spelling goes first, however crowded its neighbourhood
+            std::unordered_set<std::string> visited;
+            auto visit_once = [&](const PeerRegistry::Entry& entry, bool listed) {
+                if (visited.insert(entry.peer_id).second) {
+                    visit(entry, listed);
+                }
+            };
+            visitSellers(item, [&](const PeerRegistry::Entry& entry) { visit_once(entry, true); });
+            std::vector<ItemNameIndex::Match> matches;
+            {
+                std::shared_lock<std::shared_mutex> names_lock(names_mutex_);
+                matches = names_.fuzzyMatches(item, kMaxFuzzyNames);
+            }
+            for (const auto& match : matches) {
+                if (match.name != item) {
+                    visitSellers(match.name, [&](const PeerRegistry::Entry& entry) { visit_once(entry, false); });
+                }
+            }
+        }
+        unindexed_peers_.forEach([&](const PeerRegistry::Entry& entry) { visit(entry, false); });
+    }
+
+    // Item listings across all indexed peers
+    size_t listings() const { return listings_.load(std::memory_order_relaxed); }
+    size_t unindexedPeers() const { return unindexed_peers_.size(); }
+    // Distinct listed names, ignoring case
+    size_t listedNames() const {
+        std::shared_lock<std::shared_mutex> lock(names_mutex_);
+        return names_.size();
+    }
+
+private:
+    static constexpr size_t kShardCount = 64;
+    // Closest names a fuzzy search fans out to
+    static constexpr size_t kMaxFuzzyNames = 32;
+
+    struct ItemShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<PeerSession>>> sellers;
+    };
+
+    // What one peer published, so it can be unlisted on deregistration
+    struct PeerItems {
+        std::unordered_set<std::string> names;
+        // Sum of the names' fingerprints, wrapping
+        uint64_t digest = 0;
+        // Of the last ADD_ITEMS upload
+        int generation = 0;
+    };
+
+    struct PeerShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, PeerItems> items;
+    };
+
+    std::array<ItemShard, kShardCount> item_shards_;
+    std::array<PeerShard, kShardCount> peer_shards_;
+    PeerRegistry unindexed_peers_;
+    // Taken inside an item shard's lock when a name gains its first seller
+    // or loses its last one, and on its own for fuzzy lookups
+    mutable std::shared_mutex names_mutex_;
+    ItemNameIndex names_;
+    std::atomic<size_t> listings_{0};
+
+    ItemShard& itemShardFor(const std::string& item) {
+        return item_shards_[std::hash<std::string>{}(item) % kShardCount];
+    }
+
+    PeerShard& peerShardFor(const std::string& peer_id) {
+        return peer_shards_[std::hash<std::string>{}(peer_id) % kShardCount];
+    }
+
+    void visitSellers(const std::string& item, const std::function<void(const PeerRegistry::Entry&)>& visit) {
+        ItemShard& shard = itemShardFor(item);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sellers.find(item);
+        if (it != shard.sellers.end()) {
+            for (const auto& [peer_id, session] : it->second) {
+                visit({peer_id, session});
+            }
+        }
+    }
+
+    // Drop every name the peer listed; forget drops its entry, generation included
+    void unlistAll(const std::string& peer_id, bool forget) {
+        std::unordered_set<std::string> items;
+        {
+            PeerShard& shard = peerShardFor(peer_id);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.items.find(peer_id);
+            if (it == shard.items.end()) {
+                return;
+            }
+            items = std::move(it->second.names);
+            if (forget) {
+                shard.items.erase(it);
+            }
+            else {
+                it->second.names.clear();
+                it->second.digest = 0;
+            }
+        }
+        for (const auto& item : items) {
+            unlist(peer_id, item);
+        }
+    }
+
+    void unlist(const std::string& peer_id, const std::string& item) {
+        ItemShard& shard = itemShardFor(item);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sellers.find(item);
+        if (it == shard.sellers.end() || it->second.erase(peer_id) == 0) {
+            return;
+        }
+        if (it->second.empty()) {
+            shard.sellers.erase(it);
+            std::unique_lock<std::shared_mutex> names_lock(names_mutex_);
+            names_.erase(item);
+        }
+        listings_.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "DatagramReceiver.h"
+#include "../util/IoUring.h"
+#include "../util/Logger.h"
+
+// Receives with a single multishot RECVMSG into a provided buffer ring, so a
+// steady stream of datagrams needs no per-datagram submissions at all
+class IoUringDatagramReceiver : public DatagramReceiver {
+public:
+    IoUringDatagramReceiver(uint16_t port, bool reuse_port, BatchHandler handler)
+        : DatagramReceiver(std::move(handler)),
+          ring_(kRingEntries),
+          buffers_(std::make_unique<char[]>(static_cast<size_t>(kBufferCount) * kBufferSize)) {
+        // The ring parks the request on the socket itself, it must stay blocking
+        openSocket(port, reuse_port, false);
+
+        ring_.setupBufferRing(kBufferGroup, buffers_.get(), kBufferCount, kBufferSize);
+
+        recv_template_ = {};
+        recv_template_.msg_namelen = sizeof(sockaddr_in);
+
+        // Arm here rather than in run(): kernels with buffer rings but without
+        // multishot RECVMSG reject it straight away, and throwing now lets the
+        // server fall back to epoll
+        armReceive();
+        ring_.submit();
+        if (io_uring_cqe* cqe = ring_.peekCqe(); cqe && cqe->res < 0 && cqe->res != -ENOBUFS) {
+            throw std::runtime_error(std::string("multishot recvmsg unsupported: ") + std::strerror(-cqe->res));
+        }
+
+        // Created last, nothing after it can throw and leak the descriptor
+        wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeup_fd_ < 0) {
+            throw std::runtime_error("Failed to create wakeup eventfd");
+        }
+    }
+
+    ~IoUringDatagramReceiver() override {
+        close(wakeup_fd_);
+    }
+
+    void run(const std::atomic<bool>& running) override {
+        armWakeup();
+        ring_.submit();
+
+        while (running) {
+            if (!ring_.waitCqe()) {
+                throw std::runtime_error(std::string("io_uring wait failed: ") + std::strerror(errno));
+            }
+
+            // Reap everything that is ready and hand it over as one batch
+            std::vector<Datagram> batch;
+            bool rearm_receive = false;
+            bool returned_buffers = false;
+            bool receive_failed = false;
+            int receive_error = 0;
+            while (io_uring_cqe* cqe = ring_.peekCqe()) {
+                if (cqe->user_data == kReceiveTag) {
+                    if (handleReceive(cqe, batch)) {
+                        returned_buffers = true;
+                    }
+                    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                        // Running out of buffers ends the multishot and is
+                        // worth a re-arm, any other error would just repeat
+                        if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+                            receive_failed = true;
+                            receive_error = -cqe->res;
+                        }
+                        rearm_receive = true;
+                    }
+                }
+                else if (cqe->user_data == kWakeupTag) {
+                    uint64_t value;
+                    ssize_t ignored = read(wakeup_fd_, &value, sizeof(value));
+                    (void)ignored;
+                    armWakeup();
+                }
+                ring_.cqeSeen();
+            }
+
+            if (returned_buffers) {
+                ring_.commitBuffers();
+            }
+            if (rearm_receive && !receive_failed) {
+                armReceive();
+            }
+            ring_.submit();
+
+            deliver(std::move(batch));
+            if (receive_failed) {
+                throw std::runtime_error(std::string("io_uring recvmsg failed: ") + std::strerror(receive_error));
+            }
+        }
+    }
+
+    void wake() override {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeup_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+private:
+    static constexpr unsigned kRingEntries = 64;
+    static constexpr unsigned kBufferCount = 256;
+    static constexpr unsigned short kBufferGroup = 0;
+    // Each buffer holds the recvmsg header and source address ahead of the payload
+    static constexpr unsigned kBufferSize =
+        sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + kMaxDatagramSize;
+
+    static constexpr uint64_t kReceiveTag = 1;
+    static constexpr uint64_t kWakeupTag = 2;
+
+    IoUring ring_;
+    std::unique_ptr<char[]> buffers_;
+    msghdr recv_template_;
+    int wakeup_fd_ = -1;
+
+    void armReceive() {
+        io_uring_sqe* sqe = ring_.getSqe();
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = socket_;
+        sqe->addr = reinterpret_cast<uint64_t>(&recv_template_);
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        sqe->user_data = kReceiveTag;
+    }
+
+    void armWakeup() {
+        io_uring_sqe* sqe = ring_.getSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wakeup_fd_;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = kWakeupTag;
+    }
+
+    // Copy one completion into the batch, returns true if a buffer went back to the ring
+    bool handleReceive(io_uring_cqe* cqe, std::vector<Datagram>& batch) {
+        if (cqe->res < 0) {
+            if (cqe->res != -ENOBUFS) {
+                P2P_LOG_ERROR("io_uring recvmsg failed: " << std::strerror(-cqe->res));
+            }
+            return false;
+        }
+        if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+            return false;
+        }
+
+        auto buffer_id = static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        char* buffer = buffers_.get() + static_cast<size_t>(buffer_id) * kBufferSize;
+        auto* out = reinterpret_cast<io_uring_recvmsg_out*>(buffer);
+
+        if (out->flags & MSG_TRUNC) {
+            dropped_++;
+            P2P_LOG_WARN("Dropped oversized datagram");
+        }
+        else {
+            Datagram datagram{};
+            std::memcpy(&datagram.addr, buffer + sizeof(io_uring_recvmsg_out),
+                        std::min<size_t>(out->namelen, sizeof(sockaddr_in)));
+            const char* payload = buffer + sizeof(io_uring_recvmsg_out) + recv_template_.msg_namelen;
+            datagram.payload.assign(payload, out->payloadlen);
+            bytes_ += out->payloadlen;
+            batch.push_back(std::move(datagram));
+        }
+
+        ring_.addBuffer(buffer_id);
+        return true;
+    }
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cerrno>
+#include <sys/socket.h>
+
+#include "DatagramSender.h"
+#include "../util/IoUring.h"
+
+// Single replies keep the plain sendto path, a ring round trip per datagram
+// only adds latency. Fan-outs queue one SENDMSG per recipient on a shared ring
+// and submit the whole chunk with a single io_uring_enter.
+class IoUringDatagramSender : public SocketDatagramSender {
+public:
+    explicit IoUringDatagramSender(int socket_fd) : SocketDatagramSender(socket_fd), ring_(kRingEntries) {
+    }
+
+    SendResult sendBatch(const std::string& payload, const std::vector<sockaddr_in>& recipients) override {
+        SendResult result{0, 0, 0};
+        if (recipients.empty()) {
+            return result;
+        }
+
+        iovec iov{const_cast<char*>(payload.data()), payload.length()};
+        std::vector<msghdr> headers(recipients.size());
+        for (size_t i = 0; i < recipients.size(); ++i) {
+            headers[i] = {};
+            headers[i].msg_name = const_cast<sockaddr_in*>(&recipients[i]);
+            headers[i].msg_namelen = sizeof(sockaddr_in);
+            headers[i].msg_iov = &iov;
+            headers[i].msg_iovlen = 1;
+        }
+
+        std::lock_guard<std::mutex> lock(ring_mutex_);
+        size_t offset = 0;
+        while (offset < headers.size()) {
+            unsigned chunk = static_cast<unsigned>(std::min<size_t>(ring_.getSqEntries(), headers.size() - offset));
+            for (unsigned i = 0; i < chunk; ++i) {
+                io_uring_sqe* sqe = ring_.getSqe();
+                sqe->opcode = IORING_OP_SENDMSG;
+                sqe->fd = socket_fd_;
+                sqe->addr = reinterpret_cast<uint64_t>(&headers[offset + i]);
+                sqe->len = 1;
+                sqe->user_data = offset + i;
+            }
+
+            // The entries point into this frame: every one of them is either
+            // sent and reaped, or withdrawn, before the next chunk or return
+            unsigned submitted = submitChunk(chunk, result);
+            if (submitted < chunk) {
+                ++result.partial_sends;
+                break;
+            }
+            offset += chunk;
+        }
+        return result;
+    }
+
+private:
+    static constexpr unsigned kRingEntries = 256;
+
+    IoUring ring_;
+    std::mutex ring_mutex_;
+
+    // Keep submitting until the kernel took the whole chunk, then wait for it.
+    // On a hard error the rest is withdrawn from the queue unsent.
+    unsigned submitChunk(unsigned chunk, SendResult& result) {
+        unsigned submitted = 0;
+        unsigned in_flight = 0;
+        while (submitted < chunk) {
+            int ret = ring_.submit();
+            if (ret > 0) {
+                submitted += static_cast<unsigned>(ret);
+                in_flight += static_cast<unsigned>(ret);
+                continue;
+            }
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ret < 0 && (errno == EAGAIN || errno == EBUSY) && in_flight > 0) {
+                // Short on kernel resources, let what is in flight finish first
+                reap(in_flight, result);
+                in_flight = 0;
+                continue;
+            }
+            ring_.discardUnsubmitted();
+            break;
+        }
+        reap(in_flight, result);
+        return submitted;
+    }
+
+    // Wait for exactly count completions, the kernel owns their buffers until then
+    void reap(unsigned count, SendResult& result) {
+        while (count > 0) {
+            io_uring_cqe* cqe = ring_.waitCqe();
+            if (!cqe) {
+                continue;
+            }
+            if (cqe->res >= 0) {
+                result.sent++;
+            }
+            else if (cqe->res == -EAGAIN) {
+                result.eagain_count++;
+            }
+            ring_.cqeSeen();
+            --count;
+        }
+    }
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include "PeerSession.h"
+
+// Lock-striped peer registry. Point operations (register, deregister, lookup)
+// only lock the shard owning the key. Iteration walks immutable per-shard
+// snapshots that are rebuilt lazily after a shard changes, so a broadcast
+// never holds a lock while it sends and never blocks registrations.
+class PeerRegistry {
+public:
+    struct Entry {
+        std::string peer_id;
+        std::shared_ptr<PeerSession> session;
+    };
+
+    using Snapshot = std::vector<Entry>;
+
+    // Returns false if the peer is already registered
+    bool insert(const std::string& peer_id, std::shared_ptr<PeerSession> session) {
+        Shard& shard = shardFor(peer_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.sessions.emplace(peer_id, std::move(session)).second) {
+            return false;
+        }
+        shard.dirty.store(true, std::memory_order_release);
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool erase(const std::string& peer_id) {
+        Shard& shard = shardFor(peer_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.sessions.erase(peer_id) == 0) {
+            return false;
+        }
+        shard.dirty.store(true, std::memory_order_release);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::shared_ptr<PeerSession> find(const std::string& peer_id) {
+        Shard& shard = shardFor(peer_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(peer_id);
+        return it != shard.sessions.end() ? it->second : nullptr;
+    }
+
+    bool contains(const std::string& peer_id) {
+        Shard& shard = shardFor(peer_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.sessions.count(peer_id) > 0;
+    }
+
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+    // Visit every registered peer as of roughly now, without holding any shard lock
+    void forEach(const std::function<void(const Entry&)>& visit) {
+        for (auto& shard : shards_) {
+            std::shared_ptr<const Snapshot> snapshot = snapshotOf(shard);
+            for (const auto& entry : *snapshot) {
+                visit(entry);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kShardCount = 64;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<PeerSession>> sessions;
+        std::atomic<bool> dirty{false};
+        std::atomic<std::shared_ptr<const Snapshot>> snapshot{std::make_shared<const Snapshot>()};
+    };
+
+    std::array<Shard, kShardCount> shards_;
+    std::atomic<size_t> size_{0};
+
+    Shard& shardFor(const std::string& peer_id) {
+        return shards_[std::hash<std::string>{}(peer_id) % kShardCount];
+    }
+
+    std::shared_ptr<const Snapshot> snapshotOf(Shard& shard) {
+        if (shard.dirty.load(std::memory_order_acquire)) {
+            // Rebuild under the shard lock; writers to other shards are unaffected
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (shard.dirty.load(std::memory_order_relaxed)) {
+                auto rebuilt = std::make_shared<Snapshot>();
+                rebuilt->reserve(shard.sessions.size());
+                for (const auto& [peer_id, session] : shard.sessions) {
+                    rebuilt->push_back({peer_id, session});
+                }
+                shard.snapshot.store(std::move(rebuilt), std::memory_order_release);
+                shard.dirty.store(false, std::memory_order_relaxed);
+            }
+        }
+        return shard.snapshot.load(std::memory_order_acquire);
+    }
+};
@@ -5,21 +5,24 @@
 #include <netinet/in.h>
 
 #include "PeerStateMachine.h"
+#include "../util/WireCodec.h"
 
 class PeerSession {
 public:
-    PeerSession(int socket_fd, const sockaddr_in& peer_addr)
-            : socket_fd_(socket_fd), peer_addr_(peer_addr), state_machine_() {}
+    PeerSession(int socket_fd, const sockaddr_in& peer_addr, WireEncoding encoding = WireEncoding::JSON)
+            : socket_fd_(socket_fd), peer_addr_(peer_addr), encoding_(encoding), state_machine_() {}
 
-    void processEvent(std::shared_ptr<P2PEvent> event) {
-        state_machine_.processEvent(event);
+    void processEvent(const P2PEvent& event) {
+        state_machine_.processEvent(event.getType());
     }
 
     const sockaddr_in& getPeerAddr() const { return peer_addr_; }
     int getSocketFd() const { return socket_fd_; }
+    WireEncoding getEncoding() const { return encoding_; }
 
 private:
     int socket_fd_;
     sockaddr_in peer_addr_;
+    WireEncoding encoding_;
     PeerStateMachine state_machine_;
 };
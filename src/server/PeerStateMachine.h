@@ -4,25 +4,27 @@
 #include "../P2P/P2PEvent.h"
 #include "../P2P/P2PState.h"
 
-// Peer implementation using generic state machine
-class PeerStateMachine : public StateMachine<P2PState, P2PEvent> {
+template <>
+struct EnumCount<P2PStateType> {
+    static constexpr size_t value = static_cast<size_t>(P2PStateType::ERROR) + 1;
+};
+
+template <>
+struct EnumCount<P2PEventType> {
+    static constexpr size_t value = static_cast<size_t>(P2PEventType::UNKNOWN) + 1;
+};
+
+// Peer implementation using the enum-indexed state machine
+class PeerStateMachine : public StateMachine<P2PStateType, P2PEventType> {
 public:
     PeerStateMachine()
-            : StateMachine(std::make_shared<P2PState>(P2PStateType::UNREGISTERED)) {
-        setupTransitions();
+            : StateMachine(P2PStateType::UNREGISTERED, kTransitions) {
     }
 
+    const std::shared_ptr<P2PState>& getState() const { return P2PState::get(current_state_); }
+
 private:
-    void setupTransitions() {
-        addTransition(
-                std::make_shared<P2PState>(P2PStateType::UNREGISTERED),
-                std::make_shared<P2PEvent>(
-                        P2PEventType::REGISTER,
-                        P2PEvent::MessageData{0, ""}
-                ),
-                [](const std::shared_ptr<P2PEvent>& event) {
-                    return std::make_shared<P2PState>(P2PStateType::REGISTERING);
-                }
-        );
-    }
+    static constexpr Table kTransitions = makeTable({
+        {P2PStateType::UNREGISTERED, P2PEventType::REGISTER, P2PStateType::REGISTERING},
+    });
 };
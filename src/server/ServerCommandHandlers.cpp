@@ -3,139 +3,265 @@
 #include <unordered_map>
 #include <string>
 #include <memory>
-#include <iostream>
 #include <arpa/inet.h>
 
 #include "../util/MessageParser.h"
+#include "../util/Logger.h"
 
 ServerCommandHandlers::ServerCommandHandlers(int socket,
-                                             std::unordered_map<std::string, std::shared_ptr<PeerSession>> &peer_sessions,
-                                             std::mutex &sessions_mutex)
+                                             DatagramSender &sender,
+                                             TimerWheel &timers,
+                                             PeerRegistry &peer_registry)
         : server_socket_(socket),
-          peer_sessions_(peer_sessions),
-          sessions_mutex_(sessions_mutex) {
+          sender_(sender),
+          timers_(timers),
+          peer_registry_(peer_registry) {
     registerHandlers();
 }
 
 // Add cleanup in destructor
 ServerCommandHandlers::~ServerCommandHandlers() {
-    // Clean up any active searches
+    // Clean up any active searches, their timeouts must not fire into a dead handler
     std::lock_guard<std::mutex> lock(searches_mutex_);
+    for (const auto& [search_id, search] : active_searches_) {
+        timers_.cancel(search.timeout_timer);
+    }
     active_searches_.clear();
+    search_ids_.clear();
 }
 
-void ServerCommandHandlers::handleCommand(const json &msg, const sockaddr_in &client_addr) {
-    std::string command = msg["command"];
-    auto it = command_handlers_.find(command);
+void ServerCommandHandlers::handleCommand(const P2PEvent &event, const sockaddr_in &client_addr) {
+    auto it = command_handlers_.find(event.getType());
     if (it != command_handlers_.end()) {
-        it->second(msg, client_addr);
+        it->second(event.getData(), client_addr);
     } else {
-        std::cerr << "Unknown command: " << command << std::endl;
+        P2P_LOG_DEBUG("Unknown command: " << event.getName());
     }
 }
 
 void ServerCommandHandlers::registerHandlers() {
-    command_handlers_["REGISTER"] = [this](const json &msg, const sockaddr_in &client_addr) {
+    command_handlers_[P2PEventType::REGISTER] = [this](const MessageData &msg, const sockaddr_in &client_addr) {
         handleRegister(msg, client_addr);
     };
 
-    command_handlers_["DE_REGISTER"] = [this](const json &msg, const sockaddr_in &client_addr) {
+    command_handlers_[P2PEventType::DE_REGISTER] = [this](const MessageData &msg, const sockaddr_in &client_addr) {
         handleDeregister(msg, client_addr);
     };
 
-    command_handlers_["LOOKING_FOR"] = [this](const json &msg, const sockaddr_in &client_addr) {
+    command_handlers_[P2PEventType::LOOKING_FOR] = [this](const MessageData &msg, const sockaddr_in &client_addr) {
         handleLookingFor(msg, client_addr);
     };
 
-    command_handlers_["OFFER"] = [this](const json &msg, const sockaddr_in &client_addr) {
+    command_handlers_[P2PEventType::OFFER] = [this](const MessageData &msg, const sockaddr_in &client_addr) {
         handleOffer(msg, client_addr);
     };
+
+    command_handlers_[P2PEventType::ADD_ITEM] = [this](const MessageData &msg, const sockaddr_in &client_addr) {
+        handleAddItem(msg, client_addr);
+    };
+
+    command_handlers_[P2PEventType::REMOVE_ITEM] = [this](const MessageData &msg, const sockaddr_in &client_addr) {
+        handleRemoveItem(msg, client_addr);
+    };
+
+    command_handlers_[P2PEventType::ADD_ITEMS] = [this](const MessageData &msg, const sockaddr_in &client_addr) {
+        handleAddItems(msg, client_addr);
+    };
+
+    command_handlers_[P2PEventType::INVENTORY_CHECK] = [this](const MessageData &msg, const sockaddr_in &client_addr) {
+        handleInventoryCheck(msg, client_addr);
+    };
 }
 
-void ServerCommandHandlers::handleRegister(const json &msg, const sockaddr_in &client_addr) {
-    std::string peer_name = msg["name"];
+void ServerCommandHandlers::handleRegister(const MessageData &msg, const sockaddr_in &client_addr) {
+    const std::string &peer_name = msg.sender_name;
     std::string peer_id = getPeerIdentifier(client_addr);
 
-    std::lock_guard<std::mutex> lock(sessions_mutex_);
+    // Peers that ask for an encoding we do not know stay on JSON
+    WireEncoding encoding = WireEncoding::JSON;
+    WireCodec::encodingFromName(msg.encoding, encoding);
 
-    // Check if peer already exists
-    if (peer_sessions_.find(peer_id) != peer_sessions_.end()) {
+    // Create new peer session, the insert fails if the peer already exists
+    auto session = std::make_shared<PeerSession>(server_socket_, client_addr, encoding);
+    if (!peer_registry_.insert(peer_id, session)) {
         json response = {
                 {"command",        "REGISTER-DENIED"},
-                {"request_number", msg["rq"]},
+                {"request_number", msg.request_number},
                 {"reason",         "Peer already registered"}
         };
         sendToClient(response, client_addr);
         return;
     }
 
-    // Create new peer session
-    auto session = std::make_shared<PeerSession>(server_socket_, client_addr);
-    peer_sessions_[peer_id] = session;
-
-    // Send confirmation
+    // Send confirmation, telling the peer which encoding it was granted
     json response = {
-            {"command", "REGISTERED"},
-            {"rq",      msg["rq"]}
+            {"command",  "REGISTERED"},
+            {"rq",       msg.request_number},
+            {"encoding", WireCodec::encodingName(encoding)}
     };
 
+    // Index the published inventory; peers that publish none get every search
+    if (msg.inventory_published) {
+        inventory_index_.publish(peer_id, session, msg.inventory);
+    } else {
+        inventory_index_.addUnindexed(peer_id, std::move(session));
+    }
+
     sendToClient(response, client_addr);
-    std::cout << "Registered peer: " << peer_name << " at " << peer_id << std::endl;
+    P2P_LOG_INFO("Registered peer: " << peer_name << " at " << peer_id);
+}
+
+void ServerCommandHandlers::handleDeregister(const MessageData &msg, const sockaddr_in &client_addr) {
+    std::string peer_id = getPeerIdentifier(client_addr);
+
+    peer_registry_.erase(peer_id);
+    inventory_index_.removePeer(peer_id);
+
+    P2P_LOG_INFO("Deregistered peer: " << msg.sender_name);
+}
+
+void ServerCommandHandlers::handleAddItem(const MessageData &msg, const sockaddr_in &client_addr) {
+    std::string peer_id = getPeerIdentifier(client_addr);
+    auto session = peer_registry_.find(peer_id);
+    if (!session) {
+        P2P_LOG_DEBUG("Ignoring ADD_ITEM from unregistered peer " << peer_id);
+        return;
+    }
+
+    inventory_index_.addItem(peer_id, session, msg.item_name);
+    P2P_LOG_DEBUG("Peer " << msg.sender_name << " listed " << msg.item_name);
 }
 
-void ServerCommandHandlers::handleDeregister(const json &msg, const sockaddr_in &client_addr) {
+void ServerCommandHandlers::handleRemoveItem(const MessageData &msg, const sockaddr_in &client_addr) {
     std::string peer_id = getPeerIdentifier(client_addr);
 
-    std::lock_guard<std::mutex> lock(sessions_mutex_);
-    peer_sessions_.erase(peer_id);
+    inventory_index_.removeItem(peer_id, msg.item_name);
+    P2P_LOG_DEBUG("Peer " << msg.sender_name << " unlisted " << msg.item_name);
+}
+
+void ServerCommandHandlers::handleAddItems(const MessageData &msg, const sockaddr_in &client_addr) {
+    std::string peer_id = getPeerIdentifier(client_addr);
+    auto session = peer_registry_.find(peer_id);
+    if (!session) {
+        P2P_LOG_DEBUG("Ignoring ADD_ITEMS from unregistered peer " << peer_id);
+        return;
+    }
+
+    inventory_index_.publishChunk(peer_id, session, msg.generation, msg.inventory);
+    P2P_LOG_DEBUG("Peer " << msg.sender_name << " published " << msg.inventory.size()
+                  << " item(s), generation " << msg.generation);
+}
+
+// A lost ADD_ITEM, REMOVE_ITEM or ADD_ITEMS chunk shows up as a mismatch here,
+// and the peer answers INVENTORY_RESYNC with a full upload
+void ServerCommandHandlers::handleInventoryCheck(const MessageData &msg, const sockaddr_in &client_addr) {
+    std::string peer_id = getPeerIdentifier(client_addr);
+    if (!peer_registry_.find(peer_id)) {
+        return;
+    }
+    if (inventory_index_.inSync(peer_id, msg.inventory_count, msg.inventory_digest)) {
+        return;
+    }
 
-    std::cout << "Deregistered peer: " << msg["name"] << std::endl;
+    json response = {
+            {"command", "INVENTORY_RESYNC"},
+            {"rq",      msg.request_number}
+    };
+    sendToClient(response, client_addr);
+    P2P_LOG_DEBUG("Asked peer " << msg.sender_name << " to resync its inventory");
 }
 
-void ServerCommandHandlers::handleLookingFor(const json& msg, const sockaddr_in& client_addr) {
-    int request_number = msg["rq"];
-    std::string item_name = msg["item_name"];
-    double max_price = msg["max_price"];
+void ServerCommandHandlers::handleLookingFor(const MessageData& msg, const sockaddr_in& client_addr) {
+    int request_number = msg.request_number;
+    const std::string& item_name = msg.item_name;
+    double max_price = msg.max_price;
+
+    // Only the peers that list the item, or a close enough name for a fuzzy
+    // search, are asked, plus any that never published an inventory.
+    // Recipients are grouped by encoding so each payload is encoded only once.
+    RecipientGroups recipients;
+    std::unordered_set<std::string> invited_sellers;
+    std::unordered_set<std::string> listed_sellers;
+    std::string searcher_id = getPeerIdentifier(client_addr);
+
+    inventory_index_.forEachCandidate(item_name, msg.fuzzy, [&](const PeerRegistry::Entry& entry, bool listed) {
+        if (entry.peer_id != searcher_id) {
+            recipients[static_cast<size_t>(entry.session->getEncoding())].push_back(entry.session->getPeerAddr());
+            invited_sellers.insert(entry.peer_id);
+            if (listed && msg.expected_offers <= 0) {
+                listed_sellers.insert(entry.peer_id);
+            }
+        }
+    });
 
-    // Create new search request
+    // Create new search request. It closes once every seller listing the
+    // exact name has answered, or after as many answers as the buyer asked
+    // for. Unindexed peers and fuzzy candidates stay silent when they have
+    // nothing, so waiting on them would always run into the timeout.
     auto search = SearchRequest(
             request_number,
-            msg["name"],
+            msg.sender_name,
             item_name,
             max_price,
             client_addr
     );
+    search.expected_offers = msg.expected_offers > 0
+        ? std::min<size_t>(msg.expected_offers, invited_sellers.size())
+        : 0;
+    search.awaited_sellers = std::move(listed_sellers);
+    search.invited_sellers = std::move(invited_sellers);
+    search.good_price = msg.good_price;
+
+    // Nobody to ask: answer right away instead of after the timeout
+    if (search.invited_sellers.empty()) {
+        json reply = {
+                {"command", "NOT_AVAILABLE"},
+                {"rq", request_number},
+                {"item_name", item_name},
+                {"price", max_price}
+        };
+        sendToClient(reply, client_addr);
+        return;
+    }
 
-    // Create timeout thread
-    std::thread timeout_thread([this, request_number]() {
-        // Wait for 1 minute
-        std::this_thread::sleep_for(std::chrono::minutes(1));
-        processOffersAfterTimeout(request_number);
-    });
-    timeout_thread.detach();
+    // Every client counts rq up from 1, so sellers see a search id that is
+    // unique on this server instead; replies to the buyer keep its own rq
+    int search_id = next_search_id_.fetch_add(1, std::memory_order_relaxed);
+    search.searcher_id = searcher_id;
 
-    // Store the search request
+    // Store the search request and arm its timeout on the shared timer wheel.
+    // The same buyer reusing an rq replaces its earlier search.
     {
         std::lock_guard<std::mutex> lock(searches_mutex_);
-        active_searches_[request_number] = std::move(search);
+        auto [buyer_it, fresh] = search_ids_.try_emplace({searcher_id, request_number}, search_id);
+        if (!fresh) {
+            auto previous = active_searches_.find(buyer_it->second);
+            if (previous != active_searches_.end()) {
+                timers_.cancel(previous->second.timeout_timer);
+                active_searches_.erase(previous);
+            }
+            buyer_it->second = search_id;
+        }
+
+        search.timeout_timer = timers_.schedule(kSearchTimeout, [this, search_id] {
+            processOffersAfterTimeout(search_id);
+        });
+        active_searches_.emplace(search_id, std::move(search));
     }
 
-    // Broadcast search to all peers except searcher
+    // Send the search to candidate sellers except the searcher
     json search_broadcast = {
             {"command", "SEARCH"},
-            {"rq", request_number},
+            {"rq", search_id},
             {"item_name", item_name},
-            {"description", msg["description"]}
+            {"description", msg.item_description}
     };
-
-    std::lock_guard<std::mutex> lock(sessions_mutex_);
-    std::string searcher_id = getPeerIdentifier(client_addr);
-
-    for (const auto& [peer_id, session] : peer_sessions_) {
-        if (peer_id != searcher_id) {
-            sendToClient(search_broadcast, session->getPeerAddr());
-        }
+    // Sellers match their inventory the same way the index matched them
+    if (msg.fuzzy) {
+        search_broadcast["fuzzy"] = true;
     }
+
+    broadcastToClients(search_broadcast, recipients);
 }
 
 
@@ -144,88 +270,190 @@ std::string ServerCommandHandlers::getPeerIdentifier(const sockaddr_in &addr) {
            std::to_string(ntohs(addr.sin_port));
 }
 
+WireEncoding ServerCommandHandlers::encodingFor(const sockaddr_in &addr) {
+    auto session = peer_registry_.find(getPeerIdentifier(addr));
+    return session ? session->getEncoding() : WireEncoding::JSON;
+}
+
 void ServerCommandHandlers::sendToClient(const json &msg, const sockaddr_in &client_addr) {
-    std::string message = msg.dump();
-    sendto(server_socket_, message.c_str(), message.length(), 0,
-           (struct sockaddr *) &client_addr, sizeof(client_addr));
+    sender_.send(WireCodec::encode(msg, encodingFor(client_addr)), client_addr);
 }
 
 
-void  ServerCommandHandlers::handleOffer(const json& msg, const sockaddr_in& client_addr) {
-    int request_number = msg["rq"];
-    std::string seller_name = msg["name"];
-    std::string item_name = msg["item_name"];
-    double offer_price = msg["price"];
+void ServerCommandHandlers::broadcastToClients(const json &msg, const RecipientGroups &recipients) {
+    size_t total = 0;
+    size_t sent = 0;
+    uint64_t partial_sends = 0;
+    uint64_t eagain_count = 0;
 
-    std::lock_guard<std::mutex> lock(searches_mutex_);
-    auto search_it = active_searches_.find(request_number);
+    for (size_t i = 0; i < kWireEncodingCount; ++i) {
+        if (recipients[i].empty()) {
+            continue;
+        }
+        SendResult result = sender_.sendBatch(WireCodec::encode(msg, static_cast<WireEncoding>(i)), recipients[i]);
+        total += recipients[i].size();
+        sent += result.sent;
+        partial_sends += result.partial_sends;
+        eagain_count += result.eagain_count;
+    }
+
+    if (total == 0) {
+        return;
+    }
+
+    size_t dropped = total - sent;
+    broadcasts_++;
+    broadcast_recipients_ += total;
+    broadcast_sent_ += sent;
+    broadcast_partial_sends_ += partial_sends;
+    broadcast_eagain_ += eagain_count;
+    broadcast_dropped_ += dropped;
+
+    if (dropped > 0) {
+        P2P_LOG_WARN("Broadcast truncated: sent " << sent << "/" << total
+                     << " (partial sends: " << partial_sends
+                     << ", EAGAIN: " << eagain_count << ")");
+    }
+}
+
+ServerCommandHandlers::InventoryStats ServerCommandHandlers::getInventoryStats() const {
+    return {inventory_index_.listings(), inventory_index_.listedNames(), inventory_index_.unindexedPeers()};
+}
+
+ServerCommandHandlers::BroadcastStats ServerCommandHandlers::getBroadcastStats() const {
+    return {
+            broadcasts_.load(),
+            broadcast_recipients_.load(),
+            broadcast_sent_.load(),
+            broadcast_partial_sends_.load(),
+            broadcast_eagain_.load(),
+            broadcast_dropped_.load()
+    };
+}
+
+void  ServerCommandHandlers::handleOffer(const MessageData& msg, const sockaddr_in& client_addr) {
+    // Sellers answer with the search id they were sent
+    int search_id = msg.request_number;
+    const std::string& seller_name = msg.sender_name;
+    double offer_price = msg.price;
+    auto now = std::chrono::steady_clock::now();
+    std::string seller_id = getPeerIdentifier(client_addr);
+
+    // A seller's offers arrive in order on its strand, so the lock only has to
+    // cover the shared search table, not the logging or the reply
+    bool invited;
+    bool accepted;
+    bool closed = false;
+    json reply;
+    sockaddr_in recipient{};
+    {
+        std::lock_guard<std::mutex> lock(searches_mutex_);
+        auto search_it = active_searches_.find(search_id);
+        if (search_it == active_searches_.end() || search_it->second.offers_processed) {
+            return;
+        }
 
-    if (search_it != active_searches_.end() && !search_it->second.offers_processed) {
         auto& search = search_it->second;
-        auto now = std::chrono::steady_clock::now();
-
-        // Check if within 1-minute window
-        if (now - search.start_time < std::chrono::minutes(1)) {
-            // Add offer to the list
-            search.offers.emplace_back(seller_name, offer_price, client_addr);
-            std::cout << "Received offer from " << seller_name
-                      << " for request " << request_number
-                      << " at price " << offer_price << std::endl;
-        } else {
-            std::cout << "Dropped late offer from " << seller_name
-                      << " for request " << request_number << std::endl;
+        // Only the peers this search went to can answer it, within the 1-minute window
+        invited = search.invited_sellers.contains(seller_id);
+        accepted = invited && now - search.start_time < kSearchTimeout;
+        if (accepted) {
+            // Only the best offer is kept; a tie goes to the earlier seller
+            if (search.offers_received == 0 || offer_price < search.best_offer.price) {
+                search.best_offer = OfferInfo(seller_name, offer_price, client_addr);
+            }
+            if (search.answered_sellers.insert(seller_id).second) {
+                ++search.offers_received;
+            }
+
+            bool awaited = search.awaited_sellers.erase(seller_id) > 0;
+            bool everyone_answered = search.expected_offers > 0
+                ? search.offers_received >= search.expected_offers
+                : awaited && search.awaited_sellers.empty();
+            bool good_enough = search.good_price > 0 && search.best_offer.price <= search.good_price;
+            if (everyone_answered || good_enough) {
+                timers_.cancel(search.timeout_timer);
+                closed = closeSearch(search_it, reply, recipient);
+            }
         }
     }
+
+    if (!invited) {
+        P2P_LOG_DEBUG("Dropped offer from " << seller_id
+                      << " for search " << search_id << ", which was not sent to it");
+    } else if (accepted) {
+        P2P_LOG_DEBUG("Received offer from " << seller_name
+                      << " for search " << search_id
+                      << " at price " << offer_price);
+    } else {
+        P2P_LOG_DEBUG("Dropped late offer from " << seller_name
+                      << " for search " << search_id);
+    }
+
+    if (closed) {
+        P2P_LOG_DEBUG("Closed search " << search_id << " early");
+        sendToClient(reply, recipient);
+    }
 }
 
-void  ServerCommandHandlers::processOffersAfterTimeout(int request_number) {
-    std::lock_guard<std::mutex> lock(searches_mutex_);
-    auto search_it = active_searches_.find(request_number);
+void  ServerCommandHandlers::processOffersAfterTimeout(int search_id) {
+    json reply;
+    sockaddr_in recipient{};
 
-    if (search_it != active_searches_.end() && !search_it->second.offers_processed) {
-        auto& search = search_it->second;
-        search.offers_processed = true;
-
-        if (search.offers.empty()) {
-            // No offers received
-            json not_available_msg = {
-                    {"command", "NOT_AVAILABLE"},
-                    {"rq", search.request_number},
-                    {"item_name", search.item_name},
-                    {"price", search.max_price}
-            };
-            sendToClient(not_available_msg, search.searcher_addr);
-            active_searches_.erase(search_it);
+    // Decide under the lock, encode and send after releasing it
+    {
+        std::lock_guard<std::mutex> lock(searches_mutex_);
+        auto search_it = active_searches_.find(search_id);
+        if (search_it == active_searches_.end() ||
+            !closeSearch(search_it, reply, recipient)) {
             return;
         }
+    }
 
-        // Find lowest price offer
-        auto lowest_offer = std::min_element(
-                search.offers.begin(),
-                search.offers.end(),
-                [](const OfferInfo& a, const OfferInfo& b) {
-                    return a.price < b.price;
-                }
-        );
-
-        if (lowest_offer->price <= search.max_price) {
-            // Found an acceptable offer, notify buyer
-            json found_msg = {
-                    {"command", "FOUND"},
-                    {"rq", search.request_number},
-                    {"item_name", search.item_name},
-                    {"price", lowest_offer->price}
-            };
-            sendToClient(found_msg, search.searcher_addr);
-        } else {
-            // Best offer is above max price, try negotiation
-            json negotiate_msg = {
-                    {"command", "NEGOTIATE"},
-                    {"rq", search.request_number},
-                    {"item_name", search.item_name},
-                    {"max_price", search.max_price}
-            };
-            sendToClient(negotiate_msg, lowest_offer->seller_addr);
-        }
+    sendToClient(reply, recipient);
+}
+
+// Decide the outcome of a search from its best offer and drop it. Called
+// with searches_mutex_ held; returns false if the search was already decided.
+bool ServerCommandHandlers::closeSearch(std::unordered_map<int, SearchRequest>::iterator search_it,
+                                        json& reply, sockaddr_in& recipient) {
+    auto& search = search_it->second;
+    if (search.offers_processed) {
+        return false;
     }
+    search.offers_processed = true;
+
+    if (search.offers_received == 0) {
+        // No offers received
+        reply = {
+                {"command", "NOT_AVAILABLE"},
+                {"rq", search.request_number},
+                {"item_name", search.item_name},
+                {"price", search.max_price}
+        };
+        recipient = search.searcher_addr;
+    } else if (search.best_offer.price <= search.max_price) {
+        // Found an acceptable offer, notify buyer
+        reply = {
+                {"command", "FOUND"},
+                {"rq", search.request_number},
+                {"item_name", search.item_name},
+                {"price", search.best_offer.price}
+        };
+        recipient = search.searcher_addr;
+    } else {
+        // Best offer is above max price, try negotiation; the seller knows the search id
+        reply = {
+                {"command", "NEGOTIATE"},
+                {"rq", search_it->first},
+                {"item_name", search.item_name},
+                {"max_price", search.max_price}
+        };
+        recipient = search.best_offer.seller_addr;
+    }
+
+    // Nothing reads a decided search again, and its timer is spent or cancelled
+    search_ids_.erase({search.searcher_id, search.request_number});
+    active_searches_.erase(search_it);
+    return true;
 }
\ No newline at end of file
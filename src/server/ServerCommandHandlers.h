@@ -1,29 +1,67 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <memory>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <sys/socket.h>
 
-#include "PeerSession.h"
+#include "DatagramSender.h"
+#include "InventoryIndex.h"
+#include "PeerRegistry.h"
 #include "../util/MessageParser.h"
+#include "../util/TimerWheel.h"
+#include "../util/WireCodec.h"
 
 class ServerCommandHandlers {
 public:
     ServerCommandHandlers(int socket,
-                          std::unordered_map<std::string, std::shared_ptr<PeerSession>>& peer_sessions,
-                          std::mutex& sessions_mutex);
+                          DatagramSender& sender,
+                          TimerWheel& timers,
+                          PeerRegistry& peer_registry);
 
     ~ServerCommandHandlers();
 
-    void handleCommand(const json& msg, const sockaddr_in& client_addr);
+    // Dispatch an already parsed message, the JSON is never touched again here
+    void handleCommand(const P2PEvent& event, const sockaddr_in& client_addr);
+
+    // Cumulative counters for batched fan-outs
+    struct BroadcastStats {
+        uint64_t broadcasts;
+        uint64_t recipients;
+        uint64_t sent;
+        uint64_t partial_sends;
+        uint64_t eagain_count;
+        uint64_t dropped;
+    };
+
+    BroadcastStats getBroadcastStats() const;
+
+    struct InventoryStats {
+        size_t listings;
+        size_t listed_names;
+        size_t unindexed_peers;
+    };
+
+    InventoryStats getInventoryStats() const;
 
 private:
-    using CommandHandler = std::function<void(const json&, const sockaddr_in&)>;
+    using MessageData = P2PEvent::MessageData;
+    using CommandHandler = std::function<void(const MessageData&, const sockaddr_in&)>;
 
     int server_socket_;
-    std::unordered_map<std::string, CommandHandler> command_handlers_;
-    std::unordered_map<std::string, std::shared_ptr<PeerSession>>& peer_sessions_;
-    std::mutex& sessions_mutex_;
+    DatagramSender& sender_;
+    TimerWheel& timers_;
+
+    // How long a search collects offers before the best one is picked
+    static constexpr std::chrono::minutes kSearchTimeout{1};
+    std::unordered_map<P2PEventType, CommandHandler> command_handlers_;
+    PeerRegistry& peer_registry_;
+    // Who sells what, so a search only reaches candidate sellers
+    InventoryIndex inventory_index_;
 
     struct OfferInfo {
         std::string seller_name;
@@ -42,14 +80,29 @@ private:
     };
 
     struct SearchRequest {
+        // The buyer's own rq, used in every reply to the buyer
         int request_number;
         std::string searcher_name;
+        std::string searcher_id;
         std::string item_name;
         double max_price;
         sockaddr_in searcher_addr;
         std::chrono::steady_clock::time_point start_time;
-        std::vector<OfferInfo> offers;
+        // Kept up to date as offers arrive
+        OfferInfo best_offer;
+        size_t offers_received;
+        // Peer ids the SEARCH went to; offers from anyone else are dropped
+        std::unordered_set<std::string> invited_sellers;
+        // Peer ids that answered, a seller offering again does not count twice
+        std::unordered_set<std::string> answered_sellers;
+        // Early close: once this many sellers answered, or at or below good_price (0 = off)
+        size_t expected_offers;
+        // Without expected_offers: sellers of the exact name still to answer,
+        // the search closes when the last of them does
+        std::unordered_set<std::string> awaited_sellers;
+        double good_price;
         bool offers_processed;
+        TimerWheel::TimerId timeout_timer;
 
         // Default constructor
         SearchRequest()
@@ -59,7 +112,11 @@ private:
               , max_price(0.0)
               , searcher_addr{}
               , start_time(std::chrono::steady_clock::now())
-              , offers_processed(false) {
+              , offers_received(0)
+              , expected_offers(0)
+              , good_price(0.0)
+              , offers_processed(false)
+              , timeout_timer(0) {
         }
 
         SearchRequest(int rq, std::string name, std::string item, double price, sockaddr_in addr)
@@ -69,19 +126,57 @@ private:
               , max_price(price)
               , searcher_addr(addr)
               , start_time(std::chrono::steady_clock::now())
-              , offers_processed(false) {
+              , offers_received(0)
+              , expected_offers(0)
+              , good_price(0.0)
+              , offers_processed(false)
+              , timeout_timer(0) {
+        }
+    };
+
+    // A buyer's search as the buyer names it: its peer id and rq
+    struct BuyerRequest {
+        std::string peer_id;
+        int request_number;
+
+        bool operator==(const BuyerRequest& other) const = default;
+    };
+
+    struct BuyerRequestHash {
+        size_t operator()(const BuyerRequest& key) const {
+            return std::hash<std::string>{}(key.peer_id) * 31 + std::hash<int>{}(key.request_number);
         }
     };
 
+    // Keyed by a search id unique on this server, which is the rq sellers see
     std::unordered_map<int, SearchRequest> active_searches_;
+    std::unordered_map<BuyerRequest, int, BuyerRequestHash> search_ids_;
+    std::atomic<int> next_search_id_{1};
     std::mutex searches_mutex_;
 
+    std::atomic<uint64_t> broadcasts_{0};
+    std::atomic<uint64_t> broadcast_recipients_{0};
+    std::atomic<uint64_t> broadcast_sent_{0};
+    std::atomic<uint64_t> broadcast_partial_sends_{0};
+    std::atomic<uint64_t> broadcast_eagain_{0};
+    std::atomic<uint64_t> broadcast_dropped_{0};
+
     void registerHandlers();
-    void handleRegister(const json& msg, const sockaddr_in& client_addr);
-    void handleDeregister(const json& msg, const sockaddr_in& client_addr);
-    void handleLookingFor(const json& msg, const sockaddr_in& client_addr);
-    void handleOffer(const json& msg, const sockaddr_in& client_addr);
+    void handleRegister(const MessageData& msg, const sockaddr_in& client_addr);
+    void handleDeregister(const MessageData& msg, const sockaddr_in& client_addr);
+    void handleLookingFor(const MessageData& msg, const sockaddr_in& client_addr);
+    void handleOffer(const MessageData& msg, const sockaddr_in& client_addr);
+    void handleAddItem(const MessageData& msg, const sockaddr_in& client_addr);
+    void handleRemoveItem(const MessageData& msg, const sockaddr_in& client_addr);
+    void handleAddItems(const MessageData& msg, const sockaddr_in& client_addr);
+    void handleInventoryCheck(const MessageData& msg, const sockaddr_in& client_addr);
     std::string getPeerIdentifier(const sockaddr_in& addr);
     void sendToClient(const json& msg, const sockaddr_in& client_addr);
-    void processOffersAfterTimeout(int request_number);
+    // Recipients indexed by WireEncoding
+    using RecipientGroups = std::array<std::vector<sockaddr_in>, kWireEncodingCount>;
+
+    void broadcastToClients(const json& msg, const RecipientGroups& recipients);
+    WireEncoding encodingFor(const sockaddr_in& addr);
+    void processOffersAfterTimeout(int search_id);
+    bool closeSearch(std::unordered_map<int, SearchRequest>::iterator search_it, json& reply, sockaddr_in& recipient);
 };
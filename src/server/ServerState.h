@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <iostream>
+#include <memory>
 
 #include "../util/State.h"
 
@@ -21,6 +23,18 @@ public:
 
     ServerStateType getType() const { return type_; }
 
+    // One preallocated instance per state, shared instead of allocating per transition
+    static const std::shared_ptr<ServerState>& get(ServerStateType type) {
+        static const auto interned = [] {
+            std::array<std::shared_ptr<ServerState>, static_cast<size_t>(ServerStateType::ERROR) + 1> states;
+            for (size_t i = 0; i < states.size(); ++i) {
+                states[i] = std::make_shared<ServerState>(static_cast<ServerStateType>(i));
+            }
+            return states;
+        }();
+        return interned[static_cast<size_t>(type)];
+    }
+
     std::string getName() const override {
         switch (type_) {
         case ServerStateType::LISTENING: return "LISTENING";
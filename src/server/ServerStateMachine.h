@@ -1,34 +1,26 @@
 #pragma once
 
-#include <memory>
-
 #include "ServerState.h"
-#include "../util/StateMachine.h"
-#include "../P2P/P2PEvent.h"
+#include "PeerStateMachine.h"
+
+template <>
+struct EnumCount<ServerStateType> {
+    static constexpr size_t value = static_cast<size_t>(ServerStateType::ERROR) + 1;
+};
 
-class ServerStateMachine : public StateMachine<ServerState, P2PEvent> {
+class ServerStateMachine : public StateMachine<ServerStateType, P2PEventType> {
 public:
     ServerStateMachine()
-        : StateMachine(std::make_shared<ServerState>(ServerStateType::LISTENING)) {
-        setupTransitions();
+        : StateMachine(ServerStateType::LISTENING, kTransitions) {
     }
 
+    const std::shared_ptr<ServerState>& getState() const { return ServerState::get(current_state_); }
+
 private:
-    void setupTransitions() {
+    static constexpr Table kTransitions = makeTable({
         // Listening -> Processing Registration
-        addTransition(
-            std::make_shared<ServerState>(ServerStateType::LISTENING),
-            std::make_shared<P2PEvent>(
-                P2PEventType::REGISTER,
-                P2PEvent::MessageData{0, ""}
-            ),
-            [](const std::shared_ptr<P2PEvent>& event) {
-                return std::make_shared<ServerState>(
-                    ServerStateType::PROCESSING_REGISTRATION
-                );
-            }
-        );
+        {ServerStateType::LISTENING, P2PEventType::REGISTER, ServerStateType::PROCESSING_REGISTRATION},
 
         // Add other transitions...
-    }
+    });
 };
@@ -4,11 +4,16 @@
 
 int main(int argc, char *argv[]) {
     try {
-        // Create server with 4 worker threads
-        ConcurrentServer server(8080, 4);
+        // Defaults to port 8080 with 4 worker threads and a single epoll receiver
+        auto config = ConcurrentServer::parseCommandLine(argc, argv, 8080);
+        Logger::setLevel(config.log_level);
+        Logger::setMessageDumps(config.dump_messages);
+        ConcurrentServer server(config);
 
         // Start server
-        std::cout << "Server started on port 8080\n";
+        std::cout << "Server started on port " << config.port
+                  << " with " << config.receiver_count << " receiver(s) using "
+                  << (server.getBackend() == IoBackend::IO_URING ? "io_uring" : "epoll") << "\n";
         server.start();
     }
     catch (const std::exception &e) {
@@ -16,4 +21,4 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     return 0;
-}
+}
\ No newline at end of file
@@ -1,28 +1,244 @@
 #pragma once
 
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
 
+// Bounded lock-free MPMC ring (Vyukov). Every slot carries a sequence number
+// that tells producers and consumers whose turn it is, so the fast paths are a
+// single CAS on the tail or head. Blocking calls park on C++20 atomic waits,
+// which are only signalled when someone is actually parked.
 template <typename T>
 class ConcurrentQueue {
 public:
-    void push(T item) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        queue_.push(std::move(item));
-        lock.unlock();
-        cond_.notify_one();
+    static constexpr size_t kDefaultCapacity = 16384;
+
+    // Capacity is rounded up to a power of two
+    explicit ConcurrentQueue(size_t capacity = kDefaultCapacity)
+        : capacity_(roundUp(capacity)),
+          mask_(capacity_ - 1),
+          slots_(std::make_unique<Slot[]>(capacity_)) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~ConcurrentQueue() {
+        T item{};
+        while (try_pop(item)) {
+        }
+    }
+
+    ConcurrentQueue(const ConcurrentQueue&) = delete;
+    ConcurrentQueue& operator=(const ConcurrentQueue&) = delete;
+
+    // Blocks while the queue is full. Returns false once the queue is closed.
+    bool push(T item) {
+        if (try_push(std::move(item))) {
+            return true;
+        }
+        bool pushed = park(not_full_, [&] { return try_push(std::move(item)); });
+        if (pushed && size() < capacity_) {
+            wake(not_full_);
+        }
+        return pushed;
+    }
+
+    // Never blocks. The item is only moved from when the push succeeds.
+    bool try_push(T&& item) {
+        if (closed_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        size_t ticket = tail_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[ticket & mask_];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(ticket);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                ticket = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (slot->storage) T(std::move(item));
+        slot->sequence.store(ticket + 1, std::memory_order_release);
+        wake(not_empty_);
+        return true;
+    }
+
+    bool try_push(const T& item) {
+        T copy(item);
+        return try_push(std::move(copy));
+    }
+
+    // Blocks until an item arrives. Returns false once the queue is closed and drained.
+    bool wait_and_pop(T& item) {
+        if (try_pop(item)) {
+            return true;
+        }
+        if (park(not_empty_, [&] { return try_pop(item); })) {
+            // Pass the wakeup on if more arrived than this consumer takes
+            if (size() > 0) {
+                wake(not_empty_);
+            }
+            return true;
+        }
+        // A producer may have slipped in just before the close
+        return try_pop(item);
+    }
+
+    bool try_pop(T& item) {
+        if (!take(item)) {
+            return false;
+        }
+        wake(not_full_);
+        return true;
+    }
+
+    // Waits for at least one item, then takes up to max_items without blocking.
+    // Returns 0 only when the queue is closed and drained.
+    size_t pop_bulk(std::vector<T>& items, size_t max_items) {
+        T item{};
+        if (max_items == 0 || !wait_and_pop(item)) {
+            return 0;
+        }
+        items.push_back(std::move(item));
+
+        size_t count = 1;
+        while (count < max_items && take(item)) {
+            items.push_back(std::move(item));
+            ++count;
+        }
+        if (count > 1) {
+            wake(not_full_);
+        }
+        return count;
     }
 
-    void wait_and_pop(T& item) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        cond_.wait(lock, [this]() { return !queue_.empty(); });
-        item = std::move(queue_.front());
-        queue_.pop();
+    // Wakes every blocked caller. Pushes fail from now on, pops drain what is left.
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        for (WaitPoint* point : {&not_empty_, &not_full_}) {
+            point->signal.fetch_add(1, std::memory_order_release);
+            point->signal.notify_all();
+        }
     }
 
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // Approximate while producers and consumers are active
+    size_t size() const {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const { return capacity_; }
+
 private:
-    std::queue<T> queue_;
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    struct Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // Producers and consumers hammer different lines
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+
+    // Somewhere for callers to park until the other side makes progress
+    struct WaitPoint {
+        std::atomic<uint32_t> signal{0};
+        std::atomic<uint32_t> waiting{0};
+        // Set while a wakeup is in flight, so a burst of pushes into an empty
+        // queue costs one futex wake rather than one per item
+        std::atomic<bool> wake_pending{false};
+    };
+
+    alignas(64) WaitPoint not_empty_;
+    alignas(64) WaitPoint not_full_;
+    std::atomic<bool> closed_{false};
+
+    static size_t roundUp(size_t capacity) {
+        size_t rounded = 2;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    // Retries attempt() until it succeeds or the queue is closed, sleeping in between.
+    // Registering as a waiter before the retry pairs with the fence in wake():
+    // either the retry sees the other side's progress or wake() sees the waiter.
+    template <typename Attempt>
+    bool park(WaitPoint& point, Attempt&& attempt) {
+        while (true) {
+            point.waiting.fetch_add(1, std::memory_order_seq_cst);
+            // A wakeup aimed at a waiter that left on its own must not mute this one
+            point.wake_pending.store(false, std::memory_order_seq_cst);
+            uint32_t seen = point.signal.load(std::memory_order_seq_cst);
+            bool done = attempt();
+            bool closed = closed_.load(std::memory_order_seq_cst);
+            if (!done && !closed) {
+                point.signal.wait(seen, std::memory_order_acquire);
+            }
+            point.waiting.fetch_sub(1, std::memory_order_relaxed);
+            point.wake_pending.store(false, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (done || closed) {
+                return done;
+            }
+        }
+    }
+
+    static void wake(WaitPoint& point) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (point.waiting.load(std::memory_order_relaxed) > 0 &&
+            !point.wake_pending.exchange(true, std::memory_order_relaxed)) {
+            point.signal.fetch_add(1, std::memory_order_release);
+            point.signal.notify_one();
+        }
+    }
+
+    bool take(T& item) {
+        size_t ticket = head_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[ticket & mask_];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(ticket + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                ticket = head_.load(std::memory_order_relaxed);
+            }
+        }
+
+        T* stored = std::launder(reinterpret_cast<T*>(slot->storage));
+        item = std::move(*stored);
+        stored->~T();
+        slot->sequence.store(ticket + capacity_, std::memory_order_release);
+        return true;
+    }
 };
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only void() callable stored in a fixed inline buffer. Unlike
+// std::function it never allocates: a callable that does not fit is a
+// compile error rather than a silent trip to the heap.
+template <size_t Capacity>
+class InlineTask {
+public:
+    InlineTask() noexcept = default;
+
+    template <typename F, typename Fn = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same_v<Fn, InlineTask>>>
+    InlineTask(F&& f) {
+        static_assert(std::is_invocable_r_v<void, Fn&>, "task must be callable as void()");
+        static_assert(sizeof(Fn) <= Capacity, "callable does not fit the inline task buffer");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "callable is over-aligned");
+        static_assert(std::is_nothrow_move_constructible_v<Fn>, "callable must be nothrow movable");
+        new (storage_) Fn(std::forward<F>(f));
+        ops_ = &kOps<Fn>;
+    }
+
+    InlineTask(InlineTask&& other) noexcept {
+        moveFrom(other);
+    }
+
+    InlineTask& operator=(InlineTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    ~InlineTask() {
+        reset();
+    }
+
+    void operator()() {
+        ops_->invoke(storage_);
+    }
+
+    explicit operator bool() const noexcept {
+        return ops_ != nullptr;
+    }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* to, void* from) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template <typename Fn>
+    static constexpr Ops kOps = {
+        [](void* self) { (*static_cast<Fn*>(self))(); },
+        [](void* to, void* from) noexcept {
+            new (to) Fn(std::move(*static_cast<Fn*>(from)));
+            static_cast<Fn*>(from)->~Fn();
+        },
+        [](void* self) noexcept { static_cast<Fn*>(self)->~Fn(); }
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[Capacity];
+    const Ops* ops_ = nullptr;
+
+    void moveFrom(InlineTask& other) noexcept {
+        if (other.ops_) {
+            other.ops_->move(storage_, other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+};
@@ -0,0 +1,216 @@
+#include "IoUring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+unsigned loadAcquire(unsigned* p) {
+    return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+}
+
+void storeRelease(unsigned* p, unsigned v) {
+    std::atomic_ref<unsigned>(*p).store(v, std::memory_order_release);
+}
+}
+
+IoUring::IoUring(unsigned entries)
+    : sq_ptr_(MAP_FAILED), cq_ptr_(MAP_FAILED), sqes_(nullptr),
+      sqe_head_(0), sqe_tail_(0),
+      buf_ring_(nullptr), buf_ring_size_(0), buf_ring_mask_(0), buf_ring_tail_(0),
+      buf_base_(nullptr), buf_size_(0) {
+    io_uring_params params{};
+    ring_fd_ = ioUringSetup(entries, &params);
+    if (ring_fd_ < 0) {
+        throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+        close(ring_fd_);
+        throw std::runtime_error("Failed to map io_uring submission ring");
+    }
+
+    cq_ptr_ = single_mmap
+                  ? sq_ptr_
+                  : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED) {
+        munmap(sq_ptr_, sq_size_);
+        close(ring_fd_);
+        throw std::runtime_error("Failed to map io_uring completion ring");
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (cq_ptr_ != sq_ptr_) {
+            munmap(cq_ptr_, cq_size_);
+        }
+        munmap(sq_ptr_, sq_size_);
+        close(ring_fd_);
+        throw std::runtime_error("Failed to map io_uring submission entries");
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<char*>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+
+    auto* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    if (buf_ring_) {
+        munmap(buf_ring_, buf_ring_size_);
+    }
+    munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != sq_ptr_) {
+        munmap(cq_ptr_, cq_size_);
+    }
+    munmap(sq_ptr_, sq_size_);
+    close(ring_fd_);
+}
+
+io_uring_sqe* IoUring::getSqe() {
+    unsigned head = loadAcquire(sq_head_);
+    if (sqe_tail_ - head >= sq_entries_) {
+        return nullptr;
+    }
+    io_uring_sqe* sqe = &sqes_[sqe_tail_ & sq_mask_];
+    sqe_tail_++;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::submit(unsigned wait_nr) {
+    unsigned tail = *sq_tail_;
+    while (sqe_head_ != sqe_tail_) {
+        sq_array_[tail & sq_mask_] = sqe_head_ & sq_mask_;
+        tail++;
+        sqe_head_++;
+    }
+    storeRelease(sq_tail_, tail);
+
+    // Everything the kernel has not consumed yet, including entries a short
+    // earlier submit left behind
+    unsigned to_submit = tail - loadAcquire(sq_head_);
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int result;
+    do {
+        result = ioUringEnter(ring_fd_, to_submit, wait_nr, flags);
+    } while (result < 0 && errno == EINTR && to_submit == 0);
+    return result;
+}
+
+unsigned IoUring::discardUnsubmitted() {
+    // Without SQPOLL the kernel only reads the tail inside io_uring_enter, so
+    // pulling it back to the head withdraws the entries it never consumed
+    unsigned head = loadAcquire(sq_head_);
+    unsigned discarded = sqe_tail_ - head;
+    storeRelease(sq_tail_, head);
+    sqe_head_ = head;
+    sqe_tail_ = head;
+    return discarded;
+}
+
+io_uring_cqe* IoUring::peekCqe() {
+    unsigned head = *cq_head_;
+    if (head == loadAcquire(cq_tail_)) {
+        return nullptr;
+    }
+    return &cqes_[head & cq_mask_];
+}
+
+io_uring_cqe* IoUring::waitCqe() {
+    io_uring_cqe* cqe;
+    while (!(cqe = peekCqe())) {
+        if (ioUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            return nullptr;
+        }
+    }
+    return cqe;
+}
+
+void IoUring::cqeSeen() {
+    storeRelease(cq_head_, *cq_head_ + 1);
+}
+
+void IoUring::setupBufferRing(unsigned short group_id, char* base, unsigned count, unsigned buffer_size) {
+    if (count == 0 || (count & (count - 1)) != 0) {
+        throw std::runtime_error("Buffer ring size must be a power of two");
+    }
+
+    buf_ring_size_ = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED) {
+        throw std::runtime_error("Failed to allocate buffer ring");
+    }
+    buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+    buf_ring_mask_ = count - 1;
+    buf_base_ = base;
+    buf_size_ = buffer_size;
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = count;
+    reg.bgid = group_id;
+    if (ioUringRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        throw std::runtime_error(std::string("Failed to register buffer ring: ") + std::strerror(errno));
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        addBuffer(static_cast<unsigned short>(i));
+    }
+    commitBuffers();
+}
+
+void IoUring::addBuffer(unsigned short buffer_id) {
+    // Index the entries by hand: in C++ the header's flexible array member is
+    // preceded by an empty struct of size 1, which shifts bufs off offset 0
+    io_uring_buf* buf = reinterpret_cast<io_uring_buf*>(buf_ring_) + (buf_ring_tail_ & buf_ring_mask_);
+    buf->addr = reinterpret_cast<uint64_t>(buf_base_ + static_cast<size_t>(buffer_id) * buf_size_);
+    buf->len = buf_size_;
+    buf->bid = buffer_id;
+    buf_ring_tail_++;
+}
+
+void IoUring::commitBuffers() {
+    std::atomic_ref<__u16>(buf_ring_->tail).store(buf_ring_tail_, std::memory_order_release);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+// Minimal io_uring wrapper over the raw syscalls (no liburing dependency).
+// A ring is not thread-safe, callers serialize access themselves.
+class IoUring {
+public:
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Next free submission entry, zeroed, or nullptr when the SQ is full
+    io_uring_sqe* getSqe();
+
+    // Submit queued entries and optionally wait for wait_nr completions.
+    // Entries the kernel did not take stay queued and go with the next call.
+    int submit(unsigned wait_nr = 0);
+
+    // Drop queued entries the kernel has not consumed, returns how many
+    unsigned discardUnsubmitted();
+
+    // Completion access, peekCqe returns nullptr when the CQ is empty
+    io_uring_cqe* peekCqe();
+    io_uring_cqe* waitCqe();
+    void cqeSeen();
+
+    // Provided buffer ring: registered once, then refilled with addBuffer/commitBuffers
+    void setupBufferRing(unsigned short group_id, char* base, unsigned count, unsigned buffer_size);
+    void addBuffer(unsigned short buffer_id);
+    void commitBuffers();
+
+    unsigned getSqEntries() const { return sq_entries_; }
+
+private:
+    int ring_fd_;
+
+    void* sq_ptr_;
+    void* cq_ptr_;
+    size_t sq_size_;
+    size_t cq_size_;
+    io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_array_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned sqe_head_;
+    unsigned sqe_tail_;
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe* cqes_;
+
+    io_uring_buf_ring* buf_ring_;
+    size_t buf_ring_size_;
+    unsigned buf_ring_mask_;
+    unsigned short buf_ring_tail_;
+    char* buf_base_;
+    unsigned buf_size_;
+};
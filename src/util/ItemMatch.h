@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Item-name matching shared by the server's name index and the clients, so a
+// seller agrees with the server about what a fuzzy search matches.
+//
+// Names are compared lowercased. A fuzzy query matches a name when some
+// prefix of the name is within a small edit distance of the query, so
+// "laptop" finds "Laptop-X1" and "lpatop" still finds "laptop".
+namespace ItemMatch {
+
+inline std::string normalize(std::string_view name) {
+    std::string normalized(name);
+    for (char& c : normalized) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return normalized;
+}
+
+// Edits a fuzzy query of this length may contain; short queries only match by prefix
+inline size_t maxEdits(size_t query_length) {
+    if (query_length < 3) {
+        return 0;
+    }
+    return query_length < 6 ? 1 : 2;
+}
+
+// Distances below are only tracked up to max_edits: anything further off is
+// stored as max_edits + 1, which lets each step skip the cells outside the
+// band of width 2 * max_edits around the diagonal.
+
+inline void initialRow(std::string_view query, size_t max_edits, std::vector<size_t>& row) {
+    row.resize(query.size() + 1);
+    for (size_t i = 0; i < row.size(); ++i) {
+        row[i] = std::min(i, max_edits + 1);
+    }
+}
+
+// One step of the edit-distance table: row holds the distances from the
+// first depth - 1 characters of the name to each prefix of the query, next
+// gets them after appending c. Returns the smallest entry of next.
+inline size_t advanceRow(std::string_view query, const std::vector<size_t>& row, char c, size_t depth,
+                         size_t max_edits, std::vector<size_t>& next) {
+    size_t cap = max_edits + 1;
+    next.assign(row.size(), cap);
+    next[0] = std::min(depth, cap);
+    size_t smallest = next[0];
+    size_t low = depth > max_edits ? depth - max_edits : 1;
+    size_t high = std::min(query.size(), depth + max_edits);
+    for (size_t i = std::max<size_t>(low, 1); i <= high; ++i) {
+        size_t substitute = row[i - 1] + (query[i - 1] != c ? 1 : 0);
+        next[i] = std::min({row[i] + 1, next[i - 1] + 1, substitute, cap});
+        smallest = std::min(smallest, next[i]);
+    }
+    return smallest;
+}
+
+// Smallest edit distance between the query and any prefix of the name, or
+// max_edits + 1 if there is none within max_edits. Both must be normalized;
+// row and next are scratch space.
+inline size_t prefixDistance(std::string_view query, std::string_view name, size_t max_edits,
+                             std::vector<size_t>& row, std::vector<size_t>& next) {
+    initialRow(query, max_edits, row);
+    size_t best = row.back();
+    for (size_t depth = 1; depth <= name.size() && best > 0; ++depth) {
+        if (advanceRow(query, row, name[depth - 1], depth, max_edits, next) > max_edits) {
+            break;
+        }
+        row.swap(next);
+        best = std::min(best, row.back());
+    }
+    return best;
+}
+
+inline size_t prefixDistance(std::string_view query, std::string_view name, size_t max_edits) {
+    std::vector<size_t> row;
+    std::vector<size_t> next;
+    return prefixDistance(query, name, max_edits, row, next);
+}
+
+inline bool fuzzyMatches(std::string_view query, std::string_view name) {
+    return prefixDistance(query, name, maxEdits(query.size())) <= maxEdits(query.size());
+}
+
+// Stable 64-bit FNV-1a hash of an exact spelling. Inventory digests add these
+// up, so the client and server agree on a digest whatever order names are in.
+inline uint64_t fingerprint(std::string_view name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}
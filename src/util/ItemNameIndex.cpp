@@ -0,0 +1,319 @@
+#include "ItemNameIndex.h"
+
+#include <algorithm>
+
+#include "ItemMatch.h"
+
+void ItemNameIndex::insert(const std::string& name) {
+    std::string normalized = ItemMatch::normalize(name);
+
+    auto it = ids_.find(normalized);
+    uint32_t id = it != ids_.end() ? it->second : addEntry(normalized);
+    Entry& entry = entries_[id];
+    if (std::find(entry.names.begin(), entry.names.end(), name) != entry.names.end()) {
+        return;
+    }
+    if (entry.names.empty()) {
+        ++live_;
+    }
+    entry.names.push_back(name);
+}
+
+void ItemNameIndex::erase(const std::string& name) {
+    auto it = ids_.find(ItemMatch::normalize(name));
+    if (it == ids_.end()) {
+        return;
+    }
+    uint32_t id = it->second;
+    Entry& entry = entries_[id];
+    auto spelling = std::find(entry.names.begin(), entry.names.end(), name);
+    if (spelling == entry.names.end()) {
+        return;
+    }
+    entry.names.erase(spelling);
+    if (entry.names.empty()) {
+        --live_;
+        removeEntry(id);
+    }
+}
+
+size_t ItemNameIndex::size() const {
+    return live_;
+}
+
+std::vector<std::string> ItemNameIndex::prefixMatches(const std::string& query, size_t max_results) const {
+    std::string normalized = ItemMatch::normalize(query);
+
+    uint32_t node = 0;
+    for (char c : normalized) {
+        node = findChild(node, c);
+        if (node == kNone) {
+            return {};
+        }
+    }
+
+    std::vector<Match> found;
+    collect(node, 0, max_results, found);
+    std::vector<std::string> names;
+    names.reserve(found.size());
+    for (auto& match : found) {
+        names.push_back(std::move(match.name));
+    }
+    return names;
+}
+
+std::vector<ItemNameIndex::Match> ItemNameIndex::fuzzyMatches(const std::string& query, size_t max_results) const {
+    std::string normalized = ItemMatch::normalize(query);
+    if (normalized.empty() || max_results == 0) {
+        return {};
+    }
+    size_t max_edits = ItemMatch::maxEdits(normalized.size());
+    size_t limit = max_results * kRankingSlack;
+    std::vector<Match> found;
+
+    if (!fuzzyByTrigrams(normalized, max_edits, found)) {
+        // Nothing is cut during the walk: hits are bucketed by distance and
+        // whole subtrees only expanded closest first, up to the limit
+        FuzzyHits hits(max_edits + 1);
+        std::vector<std::vector<size_t>> rows(normalized.size() + max_edits + 2);
+        ItemMatch::initialRow(normalized, max_edits, rows[0]);
+        fuzzyWalk(normalized, 0, 0, rows[0].back(), max_edits, rows, hits);
+        for (size_t distance = 0; distance <= max_edits && found.size() < limit; ++distance) {
+            found.insert(found.end(), hits.names[distance].begin(), hits.names[distance].end());
+            for (uint32_t node : hits.subtrees[distance]) {
+                if (found.size() >= limit) {
+                    break;
+                }
+                collect(node, distance, limit, found);
+            }
+        }
+    }
+
+    std::sort(found.begin(), found.end(), [](const Match& a, const Match& b) {
+        return a.distance != b.distance ? a.distance < b.distance : a.name < b.name;
+    });
+    if (found.size() > max_results) {
+        found.resize(max_results);
+    }
+    return found;
+}
+
+// Distinct trigrams of the name padded with two NULs in front, so the first
+// characters count and a gram matches only at the same distance from the start
+std::vector<uint32_t> ItemNameIndex::trigramsOf(const std::string& normalized) {
+    std::vector<uint32_t> grams;
+    grams.reserve(normalized.size());
+    uint32_t gram = 0;
+    for (char c : normalized) {
+        gram = ((gram << 8) | static_cast<unsigned char>(c)) & 0xFFFFFF;
+        grams.push_back(gram);
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+uint32_t ItemNameIndex::findChild(uint32_t node, char label) const {
+    for (uint32_t child = nodes_[node].first_child; child != kNone; child = nodes_[child].next_sibling) {
+        if (nodes_[child].label == label) {
+            return child;
+        }
+    }
+    return kNone;
+}
+
+uint32_t ItemNameIndex::addEntry(const std::string& normalized) {
+    uint32_t id;
+    if (!free_entries_.empty()) {
+        id = free_entries_.back();
+        free_entries_.pop_back();
+        entries_[id].normalized = normalized;
+    }
+    else {
+        id = static_cast<uint32_t>(entries_.size());
+        entries_.push_back({normalized, {}});
+    }
+    ids_.emplace(normalized, id);
+
+    uint32_t node = 0;
+    for (char c : normalized) {
+        uint32_t child = findChild(node, c);
+        node = child != kNone ? child : addNode(node, c);
+    }
+    nodes_[node].entry = id;
+
+    for (uint32_t gram : trigramsOf(normalized)) {
+        trigrams_[gram].push_back(id);
+    }
+    return id;
+}
+
+uint32_t ItemNameIndex::addNode(uint32_t parent, char label) {
+    uint32_t child;
+    if (!free_nodes_.empty()) {
+        child = free_nodes_.back();
+        free_nodes_.pop_back();
+    }
+    else {
+        child = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    }
+    Node& added = nodes_[child];
+    added = Node{};
+    added.label = label;
+    added.next_sibling = nodes_[parent].first_child;
+    nodes_[parent].first_child = child;
+    return child;
+}
+
+// The entry's last spelling is gone: drop its postings, unlink the trie nodes
+// no other name passes through and put the slots on the free lists
+void ItemNameIndex::removeEntry(uint32_t id) {
+    Entry& entry = entries_[id];
+    for (uint32_t gram : trigramsOf(entry.normalized)) {
+        auto it = trigrams_.find(gram);
+        if (it == trigrams_.end()) {
+            continue;
+        }
+        // Posting order does not matter, candidates are sorted when gathered
+        auto& postings = it->second;
+        auto posting = std::find(postings.begin(), postings.end(), id);
+        if (posting != postings.end()) {
+            *posting = postings.back();
+            postings.pop_back();
+        }
+        if (postings.empty()) {
+            trigrams_.erase(it);
+        }
+    }
+
+    std::vector<uint32_t> path{0};
+    for (char c : entry.normalized) {
+        path.push_back(findChild(path.back(), c));
+    }
+    nodes_[path.back()].entry = kNone;
+    for (size_t depth = path.size() - 1; depth > 0; --depth) {
+        uint32_t node = path[depth];
+        if (nodes_[node].first_child != kNone || nodes_[node].entry != kNone) {
+            break;
+        }
+        uint32_t parent = path[depth - 1];
+        if (nodes_[parent].first_child == node) {
+            nodes_[parent].first_child = nodes_[node].next_sibling;
+        }
+        else {
+            uint32_t sibling = nodes_[parent].first_child;
+            while (nodes_[sibling].next_sibling != node) {
+                sibling = nodes_[sibling].next_sibling;
+            }
+            nodes_[sibling].next_sibling = nodes_[node].next_sibling;
+        }
+        free_nodes_.push_back(node);
+    }
+
+    ids_.erase(entry.normalized);
+    entry.normalized.clear();
+    entry.names.shrink_to_fit();
+    free_entries_.push_back(id);
+}
+
+// Every live name at or below node, until out holds limit matches
+void ItemNameIndex::collect(uint32_t node, size_t distance, size_t limit, std::vector<Match>& out) const {
+    std::vector<uint32_t> pending{node};
+    while (!pending.empty() && out.size() < limit) {
+        uint32_t current = pending.back();
+        pending.pop_back();
+        if (nodes_[current].entry != kNone) {
+            for (const auto& name : entries_[nodes_[current].entry].names) {
+                out.push_back({name, distance});
+            }
+        }
+        for (uint32_t child = nodes_[current].first_child; child != kNone; child = nodes_[child].next_sibling) {
+            pending.push_back(child);
+        }
+    }
+    if (out.size() > limit) {
+        out.resize(limit);
+    }
+}
+
+// rows[depth] holds the distance row for the path to node and best the
+// closest any prefix on that path came to the query. Entries are recorded at
+// their own distance as the walk goes; once a branch can get no closer, its
+// subtree is recorded as a whole if the path already matched, else dropped.
+void ItemNameIndex::fuzzyWalk(const std::string& query, uint32_t node, size_t depth, size_t best,
+                              size_t max_edits, std::vector<std::vector<size_t>>& rows, FuzzyHits& hits) const {
+    for (uint32_t child = nodes_[node].first_child; child != kNone; child = nodes_[child].next_sibling) {
+        std::vector<size_t>& next = rows[depth + 1];
+        size_t smallest = ItemMatch::advanceRow(query, rows[depth], nodes_[child].label, depth + 1, max_edits, next);
+        size_t child_best = std::min(best, next.back());
+        if (smallest > max_edits) {
+            // Rows never shrink again, every name below is at child_best
+            if (child_best <= max_edits) {
+                hits.subtrees[child_best].push_back(child);
+            }
+            continue;
+        }
+        if (child_best <= max_edits && nodes_[child].entry != kNone) {
+            for (const auto& name : entries_[nodes_[child].entry].names) {
+                hits.names[child_best].push_back({name, child_best});
+            }
+        }
+        fuzzyWalk(query, child, depth + 1, child_best, max_edits, rows, hits);
+    }
+}
+
+// Returns false when the filter would not prune enough to beat the trie walk
+bool ItemNameIndex::fuzzyByTrigrams(const std::string& query, size_t max_edits, std::vector<Match>& out) const {
+    std::vector<uint32_t> grams = trigramsOf(query);
+    // Each edit destroys at most three grams, so a match keeps all but 3k and
+    // is in one of the 3k + 1 shortest lists. Needs a list to spare to prune.
+    size_t needed = 3 * max_edits + 1;
+    if (grams.size() <= needed) {
+        return false;
+    }
+
+    static const std::vector<uint32_t> kEmpty;
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (uint32_t gram : grams) {
+        auto it = trigrams_.find(gram);
+        lists.push_back(it != trigrams_.end() ? &it->second : &kEmpty);
+    }
+    std::partial_sort(lists.begin(), lists.begin() + needed, lists.end(),
+                      [](const auto* a, const auto* b) { return a->size() < b->size(); });
+
+    // Common trigrams make long lists; past a point the trie walk is cheaper.
+    // Below it every candidate is checked, the caller ranks and cuts
+    size_t total = 0;
+    for (size_t i = 0; i < needed; ++i) {
+        total += lists[i]->size();
+    }
+    if (total > kMaxTrigramCandidates) {
+        return false;
+    }
+
+    std::vector<uint32_t> candidates;
+    candidates.reserve(total);
+    for (size_t i = 0; i < needed; ++i) {
+        candidates.insert(candidates.end(), lists[i]->begin(), lists[i]->end());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<size_t> row;
+    std::vector<size_t> next;
+    for (uint32_t id : candidates) {
+        const Entry& entry = entries_[id];
+        if (entry.names.empty()) {
+            continue;
+        }
+        size_t distance = ItemMatch::prefixDistance(query, entry.normalized, max_edits, row, next);
+        if (distance > max_edits) {
+            continue;
+        }
+        for (const auto& name : entry.names) {
+            out.push_back({name, distance});
+        }
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Case-insensitive index of listed item names for prefix and fuzzy lookups.
+//
+// A trie over the normalized names answers prefix queries, and fuzzy queries
+// by walking the trie with an edit-distance row, pruning any branch that is
+// already too far off. Queries long enough to have rare trigrams go through
+// a trigram index instead: a name within k edits keeps all but 3k of the
+// query's trigrams, so it must appear in one of the 3k + 1 rarest trigram
+// lists, and only those candidates are checked with the distance table.
+//
+// When the last spelling of a name goes, its trigram postings and the trie
+// nodes only it used are removed, and the entry and nodes are reused later.
+//
+// Not synchronized: an index shared between threads is locked by its owner.
+class ItemNameIndex {
+public:
+    struct Match {
+        std::string name;
+        size_t distance;
+    };
+
+    void insert(const std::string& name);
+    void erase(const std::string& name);
+
+    // Listed names starting with the query, ignoring case
+    std::vector<std::string> prefixMatches(const std::string& query, size_t max_results) const;
+
+    // Listed names with a prefix within ItemMatch::maxEdits of the query, closest first
+    std::vector<Match> fuzzyMatches(const std::string& query, size_t max_results) const;
+
+    // Distinct listed names, ignoring case
+    size_t size() const;
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+    // Fuzzy lookups gather this many times the requested results before ranking
+    static constexpr size_t kRankingSlack = 4;
+    // Above this many trigram candidates a fuzzy lookup walks the trie instead
+    static constexpr size_t kMaxTrigramCandidates = 256;
+
+    struct Node {
+        uint32_t first_child = kNone;
+        uint32_t next_sibling = kNone;
+        uint32_t entry = kNone;
+        char label = 0;
+    };
+
+    struct Entry {
+        std::string normalized;
+        // Listed spellings; none left means the slot is free
+        std::vector<std::string> names;
+    };
+
+    std::vector<Node> nodes_{Node{}};
+    std::vector<Entry> entries_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams_;
+    // Slots released by removeEntry, taken again before growing
+    std::vector<uint32_t> free_entries_;
+    std::vector<uint32_t> free_nodes_;
+    size_t live_ = 0;
+
+    static std::vector<uint32_t> trigramsOf(const std::string& normalized);
+
+    uint32_t findChild(uint32_t node, char label) const;
+    uint32_t addEntry(const std::string& normalized);
+    void removeEntry(uint32_t id);
+    uint32_t addNode(uint32_t parent, char label);
+    // What a trie walk found, indexed by edit distance
+    struct FuzzyHits {
+        explicit FuzzyHits(size_t distances) : names(distances), subtrees(distances) {
+        }
+
+        std::vector<std::vector<Match>> names;
+        // Nodes whose whole subtree matches at that distance, expanded lazily
+        std::vector<std::vector<uint32_t>> subtrees;
+    };
+
+    void collect(uint32_t node, size_t distance, size_t limit, std::vector<Match>& out) const;
+    void fuzzyWalk(const std::string& query, uint32_t node, size_t depth, size_t best, size_t max_edits,
+                   std::vector<std::vector<size_t>>& rows, FuzzyHits& hits) const;
+    bool fuzzyByTrigrams(const std::string& query, size_t max_edits, std::vector<Match>& out) const;
+};
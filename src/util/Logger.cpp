@@ -0,0 +1,198 @@
+#include "Logger.h"
+
+#include <cstdio>
+#include <cstring>
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : ring_(std::make_unique<Record[]>(kCapacity)),
+      tail_(0),
+      head_(0),
+      published_(0),
+      dropped_(0),
+      written_(0),
+      stop_(false),
+      stamp_second_(-1) {
+    for (size_t i = 0; i < kCapacity; ++i) {
+        ring_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer_ = std::thread([this] { run(); });
+}
+
+Logger::~Logger() {
+    stop_.store(true, std::memory_order_release);
+    published_.fetch_add(1, std::memory_order_release);
+    published_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+const char* Logger::levelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::TRACE: return "TRACE";
+    case LogLevel::DEBUG: return "DEBUG";
+    case LogLevel::INFO: return "INFO";
+    case LogLevel::WARN: return "WARN";
+    case LogLevel::ERROR: return "ERROR";
+    case LogLevel::OFF: return "OFF";
+    }
+    return "UNKNOWN";
+}
+
+bool Logger::levelFromName(const std::string& name, LogLevel& level) {
+    static const std::pair<const char*, LogLevel> names[] = {
+        {"trace", LogLevel::TRACE}, {"debug", LogLevel::DEBUG}, {"info", LogLevel::INFO},
+        {"warn", LogLevel::WARN}, {"error", LogLevel::ERROR}, {"off", LogLevel::OFF}
+    };
+    for (const auto& [candidate, value] : names) {
+        if (name == candidate) {
+            level = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Logger::write(LogLevel level, std::string text) {
+    auto now = std::chrono::system_clock::now();
+
+    // Claim a slot: its sequence equals the ticket when it is free for this lap
+    size_t ticket = tail_.load(std::memory_order_relaxed);
+    Record* record;
+    while (true) {
+        record = &ring_[ticket % kCapacity];
+        size_t sequence = record->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(ticket);
+        if (diff == 0) {
+            if (tail_.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // The writer has not caught up with the previous lap
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else {
+            ticket = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->level = level;
+    record->time = now;
+    record->text = std::move(text);
+    record->sequence.store(ticket + 1, std::memory_order_release);
+
+    // notify_one is a no-op unless the writer is actually parked
+    published_.fetch_add(1, std::memory_order_release);
+    published_.notify_one();
+    return true;
+}
+
+void Logger::flush() {
+    size_t target = tail_.load(std::memory_order_acquire);
+    published_.fetch_add(1, std::memory_order_release);
+    published_.notify_one();
+
+    size_t head = head_.load(std::memory_order_acquire);
+    while (head < target) {
+        head_.wait(head, std::memory_order_acquire);
+        head = head_.load(std::memory_order_acquire);
+    }
+}
+
+Logger::Stats Logger::getStats() const {
+    return {written_.load(std::memory_order_relaxed), dropped_.load(std::memory_order_relaxed)};
+}
+
+void Logger::run() {
+    std::string out;
+    std::string err;
+    uint64_t reported_drops = 0;
+
+    while (true) {
+        uint64_t seen = published_.load(std::memory_order_acquire);
+        size_t count = drain(out, err);
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reported_drops) {
+            Record notice;
+            notice.level = LogLevel::WARN;
+            notice.time = std::chrono::system_clock::now();
+            notice.text = "Logger dropped " + std::to_string(dropped - reported_drops) + " record(s), ring full";
+            append(err, notice);
+            reported_drops = dropped;
+        }
+
+        // One write and one flush per stream for the whole batch
+        if (!out.empty()) {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+            out.clear();
+        }
+        if (!err.empty()) {
+            std::fwrite(err.data(), 1, err.size(), stderr);
+            std::fflush(stderr);
+            err.clear();
+        }
+        if (count > 0) {
+            written_.fetch_add(count, std::memory_order_relaxed);
+            head_.notify_all();
+            continue;
+        }
+
+        if (stop_.load(std::memory_order_acquire)) {
+            return;
+        }
+        published_.wait(seen, std::memory_order_acquire);
+    }
+}
+
+size_t Logger::drain(std::string& out, std::string& err) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t count = 0;
+    while (true) {
+        Record& record = ring_[head % kCapacity];
+        if (record.sequence.load(std::memory_order_acquire) != head + 1) {
+            break;
+        }
+
+        append(record.level >= LogLevel::WARN ? err : out, record);
+        record.text.clear();
+        record.sequence.store(head + kCapacity, std::memory_order_release);
+        ++head;
+        ++count;
+    }
+    head_.store(head, std::memory_order_release);
+    return count;
+}
+
+void Logger::append(std::string& buffer, const Record& record) {
+    auto since_epoch = record.time.time_since_epoch();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch - seconds).count();
+
+    std::time_t second = static_cast<std::time_t>(seconds.count());
+    if (second != stamp_second_) {
+        // localtime_r, unlike localtime, does not share a static buffer across threads
+        std::tm local{};
+        localtime_r(&second, &local);
+        char stamp[32];
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+        stamp_ = stamp;
+        stamp_second_ = second;
+    }
+
+    char prefix[16];
+    std::snprintf(prefix, sizeof(prefix), ".%03d %-5s ", static_cast<int>(millis), levelName(record.level));
+
+    buffer += stamp_;
+    buffer += prefix;
+    buffer += record.text;
+    buffer += '\n';
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <ctime>
+
+enum class LogLevel { TRACE, DEBUG, INFO, WARN, ERROR, OFF };
+
+// Statements below this level are compiled out, set with -DP2P_LOG_MIN_LEVEL=<0..5>
+#ifndef P2P_LOG_MIN_LEVEL
+#define P2P_LOG_MIN_LEVEL 0
+#endif
+
+// Asynchronous logger. Callers format their line and hand it to a bounded
+// lock-free ring; one background thread stamps, writes and flushes it. A full
+// ring drops the record rather than stall a worker, drops are reported later.
+class Logger {
+public:
+    struct Stats {
+        uint64_t written;
+        uint64_t dropped;
+    };
+
+    static Logger& instance();
+
+    static void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    static LogLevel getLevel() { return level_.load(std::memory_order_relaxed); }
+    static bool enabled(LogLevel level) { return level >= level_.load(std::memory_order_relaxed); }
+
+    // Full per-message dumps are off by default, they cost far more than the message itself
+    static void setMessageDumps(bool enabled) { message_dumps_.store(enabled, std::memory_order_relaxed); }
+    static bool messageDumps() { return message_dumps_.load(std::memory_order_relaxed); }
+
+    static const char* levelName(LogLevel level);
+    static bool levelFromName(const std::string& name, LogLevel& level);
+
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Never blocks; returns false if the record was dropped
+    bool write(LogLevel level, std::string text);
+
+    // Wait until everything queued before the call has been written
+    void flush();
+
+    Stats getStats() const;
+
+private:
+    static constexpr size_t kCapacity = 8192;
+
+    struct Record {
+        std::atomic<size_t> sequence;
+        LogLevel level;
+        std::chrono::system_clock::time_point time;
+        std::string text;
+    };
+
+    static inline std::atomic<LogLevel> level_{LogLevel::INFO};
+    static inline std::atomic<bool> message_dumps_{false};
+
+    std::unique_ptr<Record[]> ring_;
+    alignas(64) std::atomic<size_t> tail_;
+    alignas(64) std::atomic<size_t> head_;
+
+    // Bumped after every publish, the writer sleeps on it when the ring is empty
+    std::atomic<uint64_t> published_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> written_;
+    std::atomic<bool> stop_;
+    std::thread writer_;
+
+    // Writer thread only: the date and time part only changes once a second
+    std::time_t stamp_second_;
+    std::string stamp_;
+
+    Logger();
+
+    void run();
+    size_t drain(std::string& out, std::string& err);
+    void append(std::string& buffer, const Record& record);
+};
+
+#define P2P_LOG(level, expr)                                                  \
+    do {                                                                      \
+        if constexpr (static_cast<int>(level) >= P2P_LOG_MIN_LEVEL) {         \
+            if (Logger::enabled(level)) {                                     \
+                std::ostringstream p2p_log_stream_;                           \
+                p2p_log_stream_ << expr;                                      \
+                Logger::instance().write(level, p2p_log_stream_.str());       \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
+
+#define P2P_LOG_TRACE(expr) P2P_LOG(LogLevel::TRACE, expr)
+#define P2P_LOG_DEBUG(expr) P2P_LOG(LogLevel::DEBUG, expr)
+#define P2P_LOG_INFO(expr) P2P_LOG(LogLevel::INFO, expr)
+#define P2P_LOG_WARN(expr) P2P_LOG(LogLevel::WARN, expr)
+#define P2P_LOG_ERROR(expr) P2P_LOG(LogLevel::ERROR, expr)
@@ -1,69 +1,131 @@
 #include "MessageParser.h"
+#include "WireCodec.h"
+#include "Logger.h"
 
-#include <iostream>
-#include <chrono>
 #include <iomanip>
 #include <sstream>
 
-std::shared_ptr<P2PEvent> MessageParser::parseMessage(const std::string& message) {
+P2PEventPool::Handle MessageParser::parseMessage(const std::string& message) {
     try {
-        auto j = json::parse(message);
+        return parseMessage(WireCodec::decode(message));
+    }
+    catch (const json::exception& e) {
+        P2P_LOG_WARN("JSON error: " << e.what());
+        return nullptr;
+    }
+}
+
+namespace {
+// Copies into the existing buffer, so a recycled event's strings are reused
+void assignString(std::string& out, const json& value) {
+    out.assign(value.get_ref<const std::string&>());
+}
 
-        // Print the incoming message
-        printMessage(j);
+void assignOptional(std::string& out, const json& j, const char* key, const char* fallback) {
+    auto it = j.find(key);
+    if (it != j.end()) {
+        assignString(out, *it);
+    }
+    else {
+        out.assign(fallback);
+    }
+}
+}
+
+P2PEventPool::Handle MessageParser::parseMessage(const json& j) {
+    try {
+        // Dump the incoming message when asked to
+        dumpMessage(j, "Received Message");
 
         // Basic validation
         if (!j.contains("command") || !j.contains("rq")) {
-            std::cerr << "Missing required fields in message" << std::endl;
+            P2P_LOG_WARN("Missing required fields in message");
             return nullptr;
         }
 
-        // Initialize message data with common fields
-        P2PEvent::MessageData data{
-            j["rq"].get<int>(),
-            j.value("name", "") // Optional for some commands
-        };
-
         // Get command type
-        auto type = stringToEventType(j["command"].get<std::string>());
+        auto type = stringToEventType(j["command"].get_ref<const std::string&>());
+
+        // Validate fields for this command type before taking an event from the pool
+        if (!validateCommandFields(j, type)) {
+            return nullptr;
+        }
+
+        // Initialize message data with common fields
+        auto event = P2PEventPool::acquire(type, j["rq"].get<int>());
+        P2PEvent::MessageData& data = event->getMutableData();
+        assignOptional(data.sender_name, j, "name", ""); // Optional for some commands
 
         // Populate command-specific fields
         switch (type) {
         case P2PEventType::REGISTER:
-            data.ip_address = j["ip"];
+            assignString(data.ip_address, j["ip"]);
             data.udp_port = j["udp_port"];
             data.tcp_port = j["tcp_port"];
+            assignOptional(data.encoding, j, "encoding", "json");
+            // Optional: peers that publish their inventory only get searches for what they sell
+            if (auto it = j.find("inventory"); it != j.end()) {
+                data.inventory_published = true;
+                for (const auto& item : *it) {
+                    data.inventory.push_back(item.get<std::string>());
+                }
+            }
+            break;
+
+        case P2PEventType::ADD_ITEM:
+        case P2PEventType::REMOVE_ITEM:
+            assignString(data.item_name, j["item_name"]);
+            break;
+
+        case P2PEventType::ADD_ITEMS:
+            data.generation = j["generation"];
+            data.inventory_published = true;
+            for (const auto& item : j["items"]) {
+                data.inventory.push_back(item.get<std::string>());
+            }
+            break;
+
+        case P2PEventType::INVENTORY_CHECK:
+            data.inventory_count = j["count"];
+            data.inventory_digest = j["digest"];
+            break;
+
+        case P2PEventType::REGISTERED:
+            assignOptional(data.encoding, j, "encoding", "json");
             break;
 
         case P2PEventType::LOOKING_FOR:
         case P2PEventType::SEARCH:
-            data.item_name = j["item_name"];
-            data.item_description = j["description"];
+            assignString(data.item_name, j["item_name"]);
+            assignString(data.item_description, j["description"]);
+            data.fuzzy = j.value("fuzzy", false);
             if (type == P2PEventType::LOOKING_FOR) {
                 data.max_price = j["max_price"];
+                data.good_price = j.value("good_price", 0.0);
+                data.expected_offers = j.value("expected_offers", 0);
             }
             break;
 
         case P2PEventType::OFFER:
-            data.item_name = j["item_name"];
+            assignString(data.item_name, j["item_name"]);
             data.price = j["price"];
             break;
 
         case P2PEventType::NEGOTIATE:
-            data.item_name = j["item_name"];
+            assignString(data.item_name, j["item_name"]);
             data.price = j["max_price"];
             break;
 
         case P2PEventType::ACCEPT:
         case P2PEventType::REFUSE:
-            data.item_name = j["item_name"];
+            assignString(data.item_name, j["item_name"]);
             data.price = j["price"];
             break;
 
         case P2PEventType::NOT_AVAILABLE:
         case P2PEventType::NOT_FOUND:
         case P2PEventType::FOUND:
-            data.item_name = j["item_name"];
+            assignString(data.item_name, j["item_name"]);
             if (j.contains("price")) {
                 data.price = j["price"];
             }
@@ -71,7 +133,7 @@ std::shared_ptr<P2PEvent> MessageParser::parseMessage(const std::string& message
 
         case P2PEventType::REGISTER_DENIED:
             if (j.contains("reason")) {
-                data.reason = j["reason"];
+                assignString(data.reason, j["reason"]);
             }
             break;
 
@@ -79,19 +141,14 @@ std::shared_ptr<P2PEvent> MessageParser::parseMessage(const std::string& message
             break;
         }
 
-        // Validate fields for this command type
-        if (!validateCommandFields(j, type)) {
-            return nullptr;
-        }
-
-        return std::make_shared<P2PEvent>(type, data);
+        return event;
     }
     catch (const json::exception& e) {
-        std::cerr << "JSON error: " << e.what() << std::endl;
+        P2P_LOG_WARN("JSON error: " << e.what());
         return nullptr;
     }
     catch (const std::exception& e) {
-        std::cerr << "Error parsing message: " << e.what() << std::endl;
+        P2P_LOG_WARN("Error parsing message: " << e.what());
         return nullptr;
     }
 }
@@ -129,64 +186,113 @@ bool MessageParser::validateCommandFields(const json& j, P2PEventType type) {
         case P2PEventType::DE_REGISTER:
             return j.contains("name");
 
+        case P2PEventType::ADD_ITEM:
+        case P2PEventType::REMOVE_ITEM:
+            return j.contains("item_name") && j.contains("name");
+
+        case P2PEventType::ADD_ITEMS:
+            return j.contains("items") && j.contains("generation") && j.contains("name");
+
+        case P2PEventType::INVENTORY_CHECK:
+            return j.contains("count") && j.contains("digest") && j.contains("name");
+
+        case P2PEventType::INVENTORY_RESYNC:
+            return true;
+
         default:
             return false;
         }
     }
     catch (const std::exception& e) {
-        std::cerr << "Validation error: " << e.what() << std::endl;
+        P2P_LOG_WARN("Validation error: " << e.what());
         return false;
     }
 }
 
-void MessageParser::printMessage(const json& j) {
+void MessageParser::dumpMessage(const json& j, const char* heading) {
+    if (static_cast<int>(LogLevel::INFO) < P2P_LOG_MIN_LEVEL ||
+        !Logger::messageDumps() || !Logger::enabled(LogLevel::INFO)) {
+        return;
+    }
+
     static const std::string separator(60, '=');
     static const std::string subseparator(60, '-');
 
-    std::cout << "\n" << separator << std::endl;
-    std::cout << "Received Message at: " << getCurrentTimestamp() << std::endl;
-    std::cout << subseparator << std::endl;
+    // Built in one piece so the dump reaches the log as a single record
+    std::ostringstream out;
+    out << heading << "\n" << separator << "\n";
 
     const std::string& command = j.value("command", "UNKNOWN");
-    std::cout << std::left << std::setw(15) << "Command:" << command << std::endl;
-    std::cout << std::left << std::setw(15) << "Request #:" << j.value("rq", -1) << std::endl;
+    out << std::left << std::setw(15) << "Command:" << command << "\n";
+    out << std::left << std::setw(15) << "Request #:" << j.value("rq", -1) << "\n";
 
     // Print command-specific fields
-    printCommandFields(j, command);
+    printCommandFields(out, j, command);
+
+    out << subseparator << "\n";
+    out << "Raw JSON:" << "\n";
+    out << j.dump(4) << "\n";
+    out << separator;
 
-    std::cout << subseparator << std::endl;
-    std::cout << "Raw JSON:" << std::endl;
-    std::cout << j.dump(4) << std::endl;
-    std::cout << separator << "\n" << std::endl;
+    Logger::instance().write(LogLevel::INFO, out.str());
 }
 
-void MessageParser::printCommandFields(const json& j, const std::string& command) {
+void MessageParser::printCommandFields(std::ostream& out, const json& j, const std::string& command) {
     if (command == "REGISTER") {
-        std::cout << std::left << std::setw(15) << "Name:" << j.value("name", "UNKNOWN") << std::endl;
-        std::cout << std::left << std::setw(15) << "IP Address:" << j.value("ip", "UNKNOWN") << std::endl;
-        std::cout << std::left << std::setw(15) << "UDP Port:" << j.value("udp_port", -1) << std::endl;
-        std::cout << std::left << std::setw(15) << "TCP Port:" << j.value("tcp_port", -1) << std::endl;
+        out << std::left << std::setw(15) << "Name:" << j.value("name", "UNKNOWN") << "\n";
+        out << std::left << std::setw(15) << "IP Address:" << j.value("ip", "UNKNOWN") << "\n";
+        out << std::left << std::setw(15) << "UDP Port:" << j.value("udp_port", -1) << "\n";
+        out << std::left << std::setw(15) << "TCP Port:" << j.value("tcp_port", -1) << "\n";
+        if (j.contains("inventory")) {
+            out << std::left << std::setw(15) << "Inventory:" << j["inventory"].size() << " item(s)\n";
+        }
     }
     else if (command == "REGISTER-DENIED") {
-        std::cout << std::left << std::setw(15) << "Reason:" << j.value("reason", "UNKNOWN") << std::endl;
+        out << std::left << std::setw(15) << "Reason:" << j.value("reason", "UNKNOWN") << "\n";
     }
     else if (command == "LOOKING_FOR" || command == "SEARCH") {
-        std::cout << std::left << std::setw(15) << "Item:" << j.value("item_name", "UNKNOWN") << std::endl;
-        std::cout << std::left << std::setw(15) << "Description:" << j.value("description", "UNKNOWN") << std::endl;
+        out << std::left << std::setw(15) << "Item:" << j.value("item_name", "UNKNOWN") << "\n";
+        out << std::left << std::setw(15) << "Description:" << j.value("description", "UNKNOWN") << "\n";
         if (j.contains("max_price")) {
-            std::cout << std::left << std::setw(15) << "Max Price:" << "$" << std::fixed
-                << std::setprecision(2) << j["max_price"].get<double>() << std::endl;
+            out << std::left << std::setw(15) << "Max Price:" << "$" << std::fixed
+                << std::setprecision(2) << j["max_price"].get<double>() << "\n";
+        }
+        if (j.contains("good_price")) {
+            out << std::left << std::setw(15) << "Good Price:" << "$" << std::fixed
+                << std::setprecision(2) << j["good_price"].get<double>() << "\n";
+        }
+        if (j.contains("expected_offers")) {
+            out << std::left << std::setw(15) << "Wait For:" << j["expected_offers"].get<int>() << " offer(s)\n";
+        }
+        if (j.value("fuzzy", false)) {
+            out << std::left << std::setw(15) << "Matching:" << "fuzzy" << "\n";
         }
     }
     else if (command == "OFFER" || command == "NEGOTIATE" || command == "ACCEPT" ||
         command == "REFUSE" || command == "NOT_AVAILABLE" || command == "NOT_FOUND" ||
         command == "FOUND" || command == "RESERVE" || command == "CANCEL" || command == "BUY") {
         if (j.contains("name")) {
-            std::cout << std::left << std::setw(15) << "Name:" << j["name"].get<std::string>() << std::endl;
+            out << std::left << std::setw(15) << "Name:" << j["name"].get<std::string>() << "\n";
         }
-        std::cout << std::left << std::setw(15) << "Item:" << j.value("item_name", "UNKNOWN") << std::endl;
-        std::cout << std::left << std::setw(15) << "Price:" << "$" << std::fixed
-            << std::setprecision(2) << j.value("price", 0.0) << std::endl;
+        out << std::left << std::setw(15) << "Item:" << j.value("item_name", "UNKNOWN") << "\n";
+        out << std::left << std::setw(15) << "Price:" << "$" << std::fixed
+            << std::setprecision(2) << j.value("price", 0.0) << "\n";
+    }
+    else if (command == "ADD_ITEM" || command == "REMOVE_ITEM") {
+        out << std::left << std::setw(15) << "Name:" << j.value("name", "UNKNOWN") << "\n";
+        out << std::left << std::setw(15) << "Item:" << j.value("item_name", "UNKNOWN") << "\n";
+    }
+    else if (command == "ADD_ITEMS") {
+        out << std::left << std::setw(15) << "Name:" << j.value("name", "UNKNOWN") << "\n";
+        out << std::left << std::setw(15) << "Generation:" << j.value("generation", -1) << "\n";
+        if (j.contains("items")) {
+            out << std::left << std::setw(15) << "Items:" << j["items"].size() << " item(s)\n";
+        }
+    }
+    else if (command == "INVENTORY_CHECK") {
+        out << std::left << std::setw(15) << "Name:" << j.value("name", "UNKNOWN") << "\n";
+        out << std::left << std::setw(15) << "Items:" << j.value("count", 0) << "\n";
+        out << std::left << std::setw(15) << "Digest:" << std::hex << j.value("digest", uint64_t{0}) << std::dec << "\n";
     }
 }
 
@@ -195,21 +301,12 @@ P2PEventType MessageParser::stringToEventType(const std::string& commandStr) {
     return it != commandMap.end() ? it->second : P2PEventType::UNKNOWN;
 }
 
-std::string MessageParser::getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto now_c = std::chrono::system_clock::to_time_t(now);
-    auto now_tm = std::localtime(&now_c);
-
-    std::stringstream ss;
-    ss << std::put_time(now_tm, "%Y-%m-%d %H:%M:%S");
-    return ss.str();
-}
-
 // Initialize the command mapping
 const std::unordered_map<std::string, P2PEventType> MessageParser::commandMap = {
     {"REGISTER", P2PEventType::REGISTER},
     {"REGISTER-DENIED", P2PEventType::REGISTER_DENIED},
     {"REGISTERED", P2PEventType::REGISTERED},
+    {"DE_REGISTER", P2PEventType::DE_REGISTER},
     {"LOOKING_FOR", P2PEventType::LOOKING_FOR},
     {"SEARCH", P2PEventType::SEARCH},
     {"OFFER", P2PEventType::OFFER},
@@ -221,5 +318,10 @@ const std::unordered_map<std::string, P2PEventType> MessageParser::commandMap =
     {"NOT_FOUND", P2PEventType::NOT_FOUND},
     {"RESERVE", P2PEventType::RESERVE},
     {"CANCEL", P2PEventType::CANCEL},
-    {"BUY", P2PEventType::BUY}
+    {"BUY", P2PEventType::BUY},
+    {"ADD_ITEM", P2PEventType::ADD_ITEM},
+    {"REMOVE_ITEM", P2PEventType::REMOVE_ITEM},
+    {"ADD_ITEMS", P2PEventType::ADD_ITEMS},
+    {"INVENTORY_CHECK", P2PEventType::INVENTORY_CHECK},
+    {"INVENTORY_RESYNC", P2PEventType::INVENTORY_RESYNC}
 };
@@ -1,24 +1,27 @@
 #pragma once
 
+#include <ostream>
 #include <string>
 #include <unordered_map>
 
 // #include <nlohmann/json.hpp>
 #include "../../libraries/json.hpp"
 
-#include "../P2P/P2PEvent.h"
+#include "../P2P/P2PEventPool.h"
 
 using json = nlohmann::json;
 
 class MessageParser {
 public:
-    static std::shared_ptr<P2PEvent> parseMessage(const std::string& message);
+    // Events come from P2PEventPool and go back to it when the handle is dropped
+    static P2PEventPool::Handle parseMessage(const std::string& message);
+    static P2PEventPool::Handle parseMessage(const json& j);
     static bool validateCommandFields(const json& j, P2PEventType type);
-    static void printMessage(const json& j);
+    // Full dump of a message, only when Logger::setMessageDumps(true)
+    static void dumpMessage(const json& j, const char* heading);
 
 private:
     static const std::unordered_map<std::string, P2PEventType> commandMap;
-    static void printCommandFields(const json& j, const std::string& command);
+    static void printCommandFields(std::ostream& out, const json& j, const std::string& command);
     static P2PEventType stringToEventType(const std::string& commandStr);
-    static std::string getCurrentTimestamp();
 };
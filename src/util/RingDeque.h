@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Growable circular buffer used as a deque. Once it has grown to the working
+// set it never allocates again, unlike std::deque which allocates and frees
+// a block every few elements as items flow through it.
+template <typename T>
+class RingDeque {
+public:
+    explicit RingDeque(size_t initial_capacity = 64)
+        : buffer_(roundUp(initial_capacity)), head_(0), size_(0) {
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    void push_back(T&& item) {
+        if (size_ == buffer_.size()) {
+            grow();
+        }
+        buffer_[(head_ + size_) & (buffer_.size() - 1)] = std::move(item);
+        ++size_;
+    }
+
+    void push_front(T&& item) {
+        if (size_ == buffer_.size()) {
+            grow();
+        }
+        head_ = (head_ + buffer_.size() - 1) & (buffer_.size() - 1);
+        buffer_[head_] = std::move(item);
+        ++size_;
+    }
+
+    T pop_front() {
+        T item = std::move(buffer_[head_]);
+        head_ = (head_ + 1) & (buffer_.size() - 1);
+        --size_;
+        return item;
+    }
+
+    T pop_back() {
+        --size_;
+        return std::move(buffer_[(head_ + size_) & (buffer_.size() - 1)]);
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t head_;
+    size_t size_;
+
+    static size_t roundUp(size_t capacity) {
+        size_t rounded = 2;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    void grow() {
+        std::vector<T> bigger(buffer_.size() * 2);
+        for (size_t i = 0; i < size_; ++i) {
+            bigger[i] = std::move(buffer_[(head_ + i) & (buffer_.size() - 1)]);
+        }
+        buffer_ = std::move(bigger);
+        head_ = 0;
+    }
+};
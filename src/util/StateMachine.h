@@ -1,10 +1,22 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <initializer_list>
 #include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+// Number of enumerators in an enum used by an enum-indexed StateMachine,
+// specialized next to the machine that uses it
+template <typename Enum>
+struct EnumCount;
 
 // Generic state machine
-template <typename StateType, typename EventType>
+template <typename StateType, typename EventType, typename = void>
 class StateMachine {
 public:
     using StatePtr = std::shared_ptr<StateType>;
@@ -45,3 +57,62 @@ protected:
     StatePtr current_state_;
     TransitionTable transitions_;
 };
+
+template <typename StateType, typename EventType>
+struct Transition {
+    StateType from;
+    EventType event;
+    StateType to;
+};
+
+// Enum-indexed state machine: the transition table is a constexpr array
+// built at compile time, so processEvent is a single lookup with no strings,
+// hashing or allocation.
+template <typename StateType, typename EventType>
+class StateMachine<StateType, EventType,
+                   std::enable_if_t<std::is_enum_v<StateType> && std::is_enum_v<EventType>>> {
+public:
+    static constexpr size_t kStateCount = EnumCount<StateType>::value;
+    static constexpr size_t kEventCount = EnumCount<EventType>::value;
+    static_assert(kStateCount < UINT8_MAX, "too many states for the table encoding");
+
+    // Target state per (state, event), kNoTransition where the event is ignored
+    using Table = std::array<std::array<uint8_t, kEventCount>, kStateCount>;
+    static constexpr uint8_t kNoTransition = UINT8_MAX;
+
+    static constexpr Table makeTable(std::initializer_list<Transition<StateType, EventType>> transitions) {
+        Table table{};
+        for (auto& row : table) {
+            for (auto& cell : row) {
+                cell = kNoTransition;
+            }
+        }
+        for (const auto& transition : transitions) {
+            table[index(transition.from)][index(transition.event)] = static_cast<uint8_t>(index(transition.to));
+        }
+        return table;
+    }
+
+    constexpr StateMachine(StateType initial_state, const Table& table)
+        : current_state_(initial_state), table_(&table) {
+    }
+
+    // Returns false if the event has no transition from the current state
+    bool processEvent(EventType event) {
+        uint8_t next = (*table_)[index(current_state_)][index(event)];
+        if (next == kNoTransition) {
+            return false;
+        }
+        current_state_ = static_cast<StateType>(next);
+        return true;
+    }
+
+    StateType getCurrentState() const { return current_state_; }
+
+protected:
+    StateType current_state_;
+    const Table* table_;
+
+    static constexpr size_t index(StateType state) { return static_cast<size_t>(state); }
+    static constexpr size_t index(EventType event) { return static_cast<size_t>(event); }
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+#include "RingDeque.h"
+#include "ThreadPool.h"
+
+// Keyed strands on top of a ThreadPool. Tasks posted under the same key run
+// one at a time in the order they were posted; different keys run in parallel.
+// A strand occupies at most one worker at a time and gives it back after a
+// fixed budget, so one chatty key cannot starve the others.
+class StrandExecutor {
+public:
+    using Task = ThreadPool::Task;
+    using Key = uint64_t;
+
+    struct Stats {
+        size_t strands;
+        uint64_t posted;
+        uint64_t executed;
+        uint64_t yields;
+    };
+
+    explicit StrandExecutor(ThreadPool& pool) : pool_(pool) {
+    }
+
+    // Running drains point at this object, wait for them to finish
+    ~StrandExecutor() {
+        size_t running;
+        while ((running = running_.load(std::memory_order_acquire)) > 0) {
+            running_.wait(running);
+        }
+    }
+
+    StrandExecutor(const StrandExecutor&) = delete;
+    StrandExecutor& operator=(const StrandExecutor&) = delete;
+
+    void post(Key key, Task&& task) {
+        Strand* strand = enqueue(key, std::move(task));
+        if (strand) {
+            pool_.post(makeDrain(key, strand));
+        }
+    }
+
+    // Queue a batch of keyed tasks, starting every strand that was idle with
+    // one postBatch on the pool. The vector is left empty for reuse.
+    void postBatch(std::vector<std::pair<Key, Task>>& tasks) {
+        thread_local std::vector<Task> drains;
+        for (auto& [key, task] : tasks) {
+            if (Strand* strand = enqueue(key, std::move(task))) {
+                drains.push_back(makeDrain(key, strand));
+            }
+        }
+        tasks.clear();
+        pool_.postBatch(drains);
+    }
+
+    Stats getStats() {
+        size_t strands = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            strands += shard.strands.size();
+        }
+        return {
+            strands,
+            posted_.load(std::memory_order_relaxed),
+            executed_.load(std::memory_order_relaxed),
+            yields_.load(std::memory_order_relaxed)
+        };
+    }
+
+private:
+    static constexpr size_t kShardCount = 64;
+    // Tasks a strand runs before it goes to the back of the pool's queue
+    static constexpr size_t kDrainBudget = 32;
+    // Idle strands are kept for reuse until a shard holds this many
+    static constexpr size_t kIdleStrandsPerShard = 256;
+
+    struct Strand {
+        RingDeque<Task> tasks{4};
+        bool scheduled = false;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, std::unique_ptr<Strand>> strands;
+    };
+
+    ThreadPool& pool_;
+    std::array<Shard, kShardCount> shards_;
+    std::atomic<size_t> running_{0};
+    std::atomic<uint64_t> posted_{0};
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> yields_{0};
+
+    Shard& shardFor(Key key) {
+        return shards_[(key * 0x9E3779B97F4A7C15ULL) >> 58];
+    }
+
+    // Returns the strand if it was idle and now needs a drain scheduled
+    Strand* enqueue(Key key, Task&& task) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto& strand = shard.strands[key];
+        if (!strand) {
+            strand = std::make_unique<Strand>();
+        }
+        strand->tasks.push_back(std::move(task));
+        posted_.fetch_add(1, std::memory_order_relaxed);
+        if (strand->scheduled) {
+            return nullptr;
+        }
+        strand->scheduled = true;
+        running_.fetch_add(1, std::memory_order_relaxed);
+        return strand.get();
+    }
+
+    Task makeDrain(Key key, Strand* strand) {
+        return [this, key, strand] { drain(key, strand); };
+    }
+
+    void drain(Key key, Strand* strand) {
+        Shard& shard = shardFor(key);
+        for (size_t budget = 0; budget < kDrainBudget; ++budget) {
+            Task task;
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                if (strand->tasks.empty()) {
+                    strand->scheduled = false;
+                    if (shard.strands.size() > kIdleStrandsPerShard) {
+                        shard.strands.erase(key);
+                    }
+                    finishDrain();
+                    return;
+                }
+                task = strand->tasks.pop_front();
+            }
+            task();
+            executed_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Still scheduled: requeue behind whatever else the pool has waiting
+        yields_.fetch_add(1, std::memory_order_relaxed);
+        pool_.post(makeDrain(key, strand));
+    }
+
+    void finishDrain() {
+        if (running_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            running_.notify_all();
+        }
+    }
+};
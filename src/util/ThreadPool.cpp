@@ -1,34 +1,250 @@
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(size_t thread_count) : stop_(false) {
+thread_local ThreadPool* ThreadPool::current_pool_ = nullptr;
+thread_local size_t ThreadPool::current_index_ = 0;
+
+ThreadPool::ThreadPool(size_t thread_count, Mode mode)
+    : mode_(mode), stop_(false), queued_(0), sleepers_(0), next_worker_(0) {
+    for (size_t i = 0; i < thread_count; ++i) {
+        worker_state_.push_back(std::make_unique<Worker>());
+    }
     for (size_t i = 0; i < thread_count; ++i) {
-        workers_.emplace_back([this] {
-            while (true) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(queue_mutex_);
-                    condition_.wait(lock, [this] {
-                        return stop_ || !tasks_.empty();
-                    });
-                    if (stop_ && tasks_.empty()) {
-                        return;
-                    }
-                    task = std::move(tasks_.front());
-                    tasks_.pop();
-                }
-                task();
+        workers_.emplace_back([this, i] {
+            current_pool_ = this;
+            current_index_ = i;
+            if (mode_ == Mode::WORK_STEALING) {
+                runStealing(i);
+            }
+            else {
+                runShared(i);
             }
         });
     }
 }
 
 ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+void ThreadPool::shutdown() {
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
+        std::unique_lock<std::mutex> idle_lock(idle_mutex_);
         stop_ = true;
     }
     condition_.notify_all();
+    idle_condition_.notify_all();
     for (std::thread& worker : workers_) {
-        worker.join();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void ThreadPool::throwIfStopped() const {
+    // A task draining during shutdown may still requeue itself (strands yield this way)
+    if (stop_ && current_pool_ != this) {
+        throw std::runtime_error("Cannot enqueue on stopped thread pool");
+    }
+}
+
+void ThreadPool::submit(Task&& task) {
+    if (mode_ == Mode::SHARED_QUEUE) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            throwIfStopped();
+            tasks_.push_back(std::move(task));
+        }
+        condition_.notify_one();
+        return;
+    }
+
+    throwIfStopped();
+    // From a worker the task stays local, anything else is spread round-robin
+    size_t index = current_pool_ == this
+        ? current_index_
+        : next_worker_.fetch_add(1, std::memory_order_relaxed) % worker_state_.size();
+    Worker& worker = *worker_state_[index];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    wakeWorkers(1);
+}
+
+void ThreadPool::enqueueBatch(std::vector<std::function<void()>>&& tasks) {
+    std::vector<Task> wrapped;
+    wrapped.reserve(tasks.size());
+    for (auto& task : tasks) {
+        wrapped.emplace_back(std::move(task));
+    }
+    postBatch(wrapped);
+}
+
+void ThreadPool::postBatch(std::vector<Task>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    size_t count = tasks.size();
+
+    if (mode_ == Mode::SHARED_QUEUE) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            throwIfStopped();
+            for (auto& task : tasks) {
+                tasks_.push_back(std::move(task));
+            }
+        }
+        tasks.clear();
+        if (count == 1) {
+            condition_.notify_one();
+        }
+        else {
+            condition_.notify_all();
+        }
+        return;
+    }
+
+    throwIfStopped();
+    if (current_pool_ == this) {
+        Worker& worker = *worker_state_[current_index_];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        for (auto& task : tasks) {
+            worker.tasks.push_back(std::move(task));
+        }
+    }
+    else {
+        // The whole batch goes to one deque under one lock, idle workers steal their share
+        Worker& worker = *worker_state_[next_worker_.fetch_add(1, std::memory_order_relaxed) % worker_state_.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        for (auto& task : tasks) {
+            worker.tasks.push_back(std::move(task));
+        }
+    }
+    tasks.clear();
+    wakeWorkers(count);
+}
+
+void ThreadPool::wakeWorkers(size_t count) {
+    queued_.fetch_add(count, std::memory_order_seq_cst);
+    // Pairs with the sleeper count bump in runStealing: either the sleeper
+    // sees queued_ move or we see the sleeper
+    if (sleepers_.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    if (count == 1) {
+        idle_condition_.notify_one();
+    }
+    else {
+        idle_condition_.notify_all();
+    }
+}
+
+std::vector<ThreadPool::WorkerStats> ThreadPool::getWorkerStats() const {
+    std::vector<WorkerStats> stats;
+    stats.reserve(worker_state_.size());
+    for (const auto& worker : worker_state_) {
+        stats.push_back({
+            worker->executed.load(std::memory_order_relaxed),
+            worker->steals.load(std::memory_order_relaxed),
+            worker->idle.load(std::memory_order_relaxed)
+        });
+    }
+    return stats;
+}
+
+void ThreadPool::runShared(size_t index) {
+    Worker& self = *worker_state_[index];
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (tasks_.empty() && !stop_) {
+                self.idle.fetch_add(1, std::memory_order_relaxed);
+            }
+            condition_.wait(lock, [this] {
+                return stop_ || !tasks_.empty();
+            });
+            if (stop_ && tasks_.empty()) {
+                return;
+            }
+            task = tasks_.pop_front();
+        }
+        task();
+        self.executed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ThreadPool::runStealing(size_t index) {
+    Worker& self = *worker_state_[index];
+    while (true) {
+        Task task;
+        if (popLocal(index, task) || steal(index, task)) {
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            self.executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        if (queued_.load(std::memory_order_seq_cst) == 0 && !stop_) {
+            self.idle.fetch_add(1, std::memory_order_relaxed);
+            idle_condition_.wait(lock, [this] {
+                return stop_ || queued_.load(std::memory_order_seq_cst) > 0;
+            });
+        }
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        if (stop_ && queued_.load(std::memory_order_seq_cst) == 0) {
+            return;
+        }
+    }
+}
+
+// The owner works newest-first, which keeps freshly spawned work cache-warm
+bool ThreadPool::popLocal(size_t index, Task& task) {
+    Worker& self = *worker_state_[index];
+    std::lock_guard<std::mutex> lock(self.mutex);
+    if (self.tasks.empty()) {
+        return false;
+    }
+    task = self.tasks.pop_back();
+    return true;
+}
+
+// Thieves take the older half of the first non-empty deque after their own,
+// so a burst landing on one worker spreads out in a few steals
+bool ThreadPool::steal(size_t index, Task& task) {
+    Worker& self = *worker_state_[index];
+    size_t worker_count = worker_state_.size();
+    for (size_t offset = 1; offset < worker_count; ++offset) {
+        Worker& victim = *worker_state_[(index + offset) % worker_count];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) {
+            continue;
+        }
+
+        size_t take = (victim.tasks.size() + 1) / 2;
+        std::vector<Task>& stolen = self.stolen;
+        for (size_t i = 0; i < take; ++i) {
+            stolen.push_back(victim.tasks.pop_front());
+        }
+        lock.unlock();
+
+        task = std::move(stolen.front());
+        if (stolen.size() > 1) {
+            std::lock_guard<std::mutex> self_lock(self.mutex);
+            // The rest keeps its original order at the steal end of our deque
+            for (auto it = stolen.rbegin(); it != stolen.rend() - 1; ++it) {
+                self.tasks.push_front(std::move(*it));
+            }
+        }
+        stolen.clear();
+        self.steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
     }
+    return false;
 }
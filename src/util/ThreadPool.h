@@ -1,42 +1,113 @@
 #pragma once
 
 #include <thread>
-#include <queue>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <future>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <stdexcept>
+#include <cstdint>
+#include <type_traits>
+
+#include "InlineTask.h"
+#include "RingDeque.h"
 
 
 // Thread pool for handling concurrent peer connections
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t thread_count);
+    enum class Mode {
+        // One queue shared by every worker
+        SHARED_QUEUE,
+        // A deque per worker; idle workers steal from the others
+        WORK_STEALING
+    };
+
+    struct WorkerStats {
+        uint64_t executed;
+        uint64_t steals;
+        uint64_t idle;
+    };
+
+    // Room for a this pointer, a moved-in std::string and a sockaddr_in, with some to spare
+    static constexpr size_t kTaskCapacity = 64;
+    using Task = InlineTask<kTaskCapacity>;
 
+    explicit ThreadPool(size_t thread_count, Mode mode = Mode::SHARED_QUEUE);
+
+    // For callers that want the result. Allocates the shared state behind the future.
     template <typename F>
-    auto enqueue(F&& f) -> std::future<typename std::result_of<F()>::type> {
-        using return_type = typename std::result_of<F()>::type;
+    auto enqueue(F&& f) -> std::future<std::invoke_result_t<F>> {
+        using return_type = std::invoke_result_t<F>;
         auto task = std::make_shared<std::packaged_task<return_type()>>(std::forward<F>(f));
         std::future<return_type> result = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            if (stop_) {
-                throw std::runtime_error("Cannot enqueue on stopped thread pool");
-            }
-            tasks_.emplace([task]() { (*task)(); });
-        }
-        condition_.notify_one();
+        submit(Task([task]() { (*task)(); }));
         return result;
     }
 
+    // Fire-and-forget: the callable is stored inline in the queue slot, nothing is allocated
+    template <typename F>
+    void post(F&& f) {
+        submit(Task(std::forward<F>(f)));
+    }
+
+    // Hand over a batch with one lock acquisition and one wakeup. The vector is
+    // left empty with its capacity intact so the caller can reuse it.
+    void postBatch(std::vector<Task>& tasks);
+
+    // Same for std::function callbacks (the timer wheel hands these over)
+    void enqueueBatch(std::vector<std::function<void()>>&& tasks);
+
+    Mode getMode() const { return mode_; }
+
+    std::vector<WorkerStats> getWorkerStats() const;
+
+    // Stop taking new work from outside and join the workers once every queued
+    // task has run. Running tasks may still post follow-ups, those run too.
+    void shutdown();
+
     ~ThreadPool();
 
 private:
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        RingDeque<Task> tasks;
+        // Owner-only scratch space for a steal, reused to avoid allocating
+        std::vector<Task> stolen;
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> idle{0};
+    };
+
+    Mode mode_;
     std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
+    std::vector<std::unique_ptr<Worker>> worker_state_;
+    std::atomic<bool> stop_;
+
+    // Shared-queue mode
+    RingDeque<Task> tasks_;
     std::mutex queue_mutex_;
     std::condition_variable condition_;
-    bool stop_;
+
+    // Work-stealing mode: idle workers sleep here until queued_ moves
+    std::atomic<size_t> queued_;
+    std::atomic<size_t> sleepers_;
+    std::atomic<size_t> next_worker_;
+    std::mutex idle_mutex_;
+    std::condition_variable idle_condition_;
+
+    // Lets a task find its own worker's deque
+    static thread_local ThreadPool* current_pool_;
+    static thread_local size_t current_index_;
+
+    void submit(Task&& task);
+    void runShared(size_t index);
+    void runStealing(size_t index);
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t index, Task& task);
+    void wakeWorkers(size_t count);
+    void throwIfStopped() const;
 };
@@ -0,0 +1,152 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds resolution, Dispatcher dispatcher)
+    : resolution_(resolution),
+      dispatcher_(std::move(dispatcher)),
+      start_time_(std::chrono::steady_clock::now()),
+      current_tick_(0),
+      next_id_(1),
+      slots_(kLevels * kSlotCount),
+      scheduled_(0),
+      fired_(0),
+      cancelled_(0),
+      stop_(false) {
+    thread_ = std::thread([this] { run(); });
+}
+
+TimerWheel::~TimerWheel() {
+    stop();
+}
+
+void TimerWheel::stop() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback) {
+    uint64_t ticks = (delay.count() + resolution_.count() - 1) / resolution_.count();
+    bool was_idle;
+    TimerId id;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        was_idle = pending_.empty();
+        if (was_idle) {
+            // Nothing was pending, so skip the idle ticks and drop cancelled leftovers
+            for (auto& slot : slots_) {
+                slot.clear();
+            }
+            current_tick_ = tickFor(std::chrono::steady_clock::now());
+        }
+        id = next_id_++;
+        insert({id, current_tick_ + std::max<uint64_t>(ticks, 1), std::move(callback)});
+        pending_.insert(id);
+        scheduled_++;
+    }
+    // The wheel thread sleeps indefinitely while there is nothing to time
+    if (was_idle) {
+        condition_.notify_one();
+    }
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (pending_.erase(id) == 0) {
+        return false;
+    }
+    cancelled_++;
+    return true;
+}
+
+TimerWheel::Stats TimerWheel::getStats() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return {pending_.size(), scheduled_, fired_, cancelled_};
+}
+
+void TimerWheel::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        if (pending_.empty()) {
+            condition_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+            continue;
+        }
+
+        auto next_tick_time = start_time_ + resolution_ * (current_tick_ + 1);
+        condition_.wait_until(lock, next_tick_time, [this] { return stop_; });
+        if (stop_) {
+            return;
+        }
+
+        std::vector<Callback> expired;
+        uint64_t now_tick = tickFor(std::chrono::steady_clock::now());
+        while (current_tick_ < now_tick) {
+            advance(expired);
+        }
+
+        if (!expired.empty()) {
+            fired_ += expired.size();
+            lock.unlock();
+            dispatcher_(std::move(expired));
+            lock.lock();
+        }
+    }
+}
+
+void TimerWheel::insert(Timer&& timer) {
+    // Only cascades can hand over a timer due this very tick, it lands in the slot about to fire
+    if (timer.expiry_tick < current_tick_) {
+        timer.expiry_tick = current_tick_;
+    }
+
+    // Lowest level whose parent block holds both now and the expiry
+    unsigned level = 0;
+    while (level < kLevels - 1 &&
+        (timer.expiry_tick >> (kSlotBits * (level + 1))) != (current_tick_ >> (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+
+    unsigned slot = (timer.expiry_tick >> (kSlotBits * level)) & kSlotMask;
+    slots_[level * kSlotCount + slot].push_back(std::move(timer));
+}
+
+void TimerWheel::cascade(unsigned level) {
+    unsigned slot = (current_tick_ >> (kSlotBits * level)) & kSlotMask;
+    std::vector<Timer> timers = std::move(slots_[level * kSlotCount + slot]);
+    slots_[level * kSlotCount + slot].clear();
+    for (auto& timer : timers) {
+        if (pending_.count(timer.id)) {
+            insert(std::move(timer));
+        }
+    }
+}
+
+void TimerWheel::advance(std::vector<Callback>& expired) {
+    ++current_tick_;
+
+    // Entering a new block at some level pulls its timers down a level
+    for (unsigned level = kLevels - 1; level > 0; --level) {
+        if ((current_tick_ & ((uint64_t(1) << (kSlotBits * level)) - 1)) == 0) {
+            cascade(level);
+        }
+    }
+
+    auto& slot = slots_[current_tick_ & kSlotMask];
+    for (auto& timer : slot) {
+        if (pending_.erase(timer.id)) {
+            expired.push_back(std::move(timer.callback));
+        }
+    }
+    slot.clear();
+}
+
+uint64_t TimerWheel::tickFor(std::chrono::steady_clock::time_point time) const {
+    return static_cast<uint64_t>((time - start_time_) / resolution_);
+}
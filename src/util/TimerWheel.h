@@ -0,0 +1,80 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <unordered_set>
+#include <cstdint>
+
+// Hierarchical timer wheel driven by a single thread. Expired callbacks are not
+// run on the wheel thread, they are handed to the dispatcher (usually the
+// ThreadPool) in one batch per tick.
+class TimerWheel {
+public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+    using Dispatcher = std::function<void(std::vector<Callback>&&)>;
+
+    struct Stats {
+        size_t pending;
+        uint64_t scheduled;
+        uint64_t fired;
+        uint64_t cancelled;
+    };
+
+    TimerWheel(std::chrono::milliseconds resolution, Dispatcher dispatcher);
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback);
+
+    // Returns false if the timer already fired or was cancelled
+    bool cancel(TimerId id);
+
+    void stop();
+
+    Stats getStats();
+
+private:
+    // 4 levels of 64 slots: 64, 4096, 262144 and 16777216 ticks
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr unsigned kSlotCount = 1u << kSlotBits;
+    static constexpr unsigned kSlotMask = kSlotCount - 1;
+    static constexpr unsigned kLevels = 4;
+
+    struct Timer {
+        TimerId id;
+        uint64_t expiry_tick;
+        Callback callback;
+    };
+
+    std::chrono::milliseconds resolution_;
+    Dispatcher dispatcher_;
+    std::chrono::steady_clock::time_point start_time_;
+    uint64_t current_tick_;
+    TimerId next_id_;
+
+    // Cancelled timers stay in their slot and are skipped when it comes due
+    std::vector<std::vector<Timer>> slots_;
+    std::unordered_set<TimerId> pending_;
+
+    uint64_t scheduled_;
+    uint64_t fired_;
+    uint64_t cancelled_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_;
+    std::thread thread_;
+
+    void run();
+    void insert(Timer&& timer);
+    void cascade(unsigned level);
+    void advance(std::vector<Callback>& expired);
+    uint64_t tickFor(std::chrono::steady_clock::time_point time) const;
+};
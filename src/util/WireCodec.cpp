@@ -0,0 +1,66 @@
+#include "WireCodec.h"
+
+std::string WireCodec::encode(const json& j, WireEncoding encoding) {
+    std::string out;
+    switch (encoding) {
+    case WireEncoding::MSGPACK:
+        json::to_msgpack(j, out);
+        return out;
+    case WireEncoding::CBOR:
+        json::to_cbor(j, out);
+        return out;
+    default:
+        return j.dump();
+    }
+}
+
+json WireCodec::decode(const std::string& payload) {
+    switch (detectEncoding(payload)) {
+    case WireEncoding::MSGPACK:
+        return json::from_msgpack(payload);
+    case WireEncoding::CBOR:
+        return json::from_cbor(payload);
+    default:
+        return json::parse(payload);
+    }
+}
+
+WireEncoding WireCodec::detectEncoding(const std::string& payload) {
+    if (payload.empty()) {
+        return WireEncoding::JSON;
+    }
+
+    // Every message is a map: fixmap/map16/map32 in MessagePack, major type 5 in CBOR
+    auto lead = static_cast<unsigned char>(payload[0]);
+    if ((lead >= 0x80 && lead <= 0x8f) || lead == 0xde || lead == 0xdf) {
+        return WireEncoding::MSGPACK;
+    }
+    if (lead >= 0xa0 && lead <= 0xbf) {
+        return WireEncoding::CBOR;
+    }
+    return WireEncoding::JSON;
+}
+
+std::string WireCodec::encodingName(WireEncoding encoding) {
+    switch (encoding) {
+    case WireEncoding::MSGPACK: return "msgpack";
+    case WireEncoding::CBOR: return "cbor";
+    default: return "json";
+    }
+}
+
+bool WireCodec::encodingFromName(const std::string& name, WireEncoding& encoding) {
+    if (name == "json") {
+        encoding = WireEncoding::JSON;
+    }
+    else if (name == "msgpack") {
+        encoding = WireEncoding::MSGPACK;
+    }
+    else if (name == "cbor") {
+        encoding = WireEncoding::CBOR;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
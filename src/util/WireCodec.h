@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+// #include <nlohmann/json.hpp>
+#include "../../libraries/json.hpp"
+
+using json = nlohmann::json;
+
+// On-the-wire encodings a peer can negotiate at REGISTER time
+enum class WireEncoding {
+    JSON,
+    MSGPACK,
+    CBOR
+};
+
+constexpr size_t kWireEncodingCount = 3;
+
+class WireCodec {
+public:
+    static std::string encode(const json& j, WireEncoding encoding);
+
+    // The encoding is detected from the first byte, so JSON peers need no negotiation
+    static json decode(const std::string& payload);
+    static WireEncoding detectEncoding(const std::string& payload);
+
+    static std::string encodingName(WireEncoding encoding);
+    static bool encodingFromName(const std::string& name, WireEncoding& encoding);
+};